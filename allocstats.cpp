@@ -0,0 +1,191 @@
+/**
+ *  This program creates an SVG (Scalable Vector Graphics) symbol out of
+ *  a VHDL entity
+ *
+ *  Copyright (C) 2019  Frans Schreuder info@schreuderelectronics.com
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "allocstats.h"
+#include "svgwriter.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+#ifdef ENTITYBLOCK_ALLOC_STATS
+#include <malloc.h>
+#include <errno.h>
+#include <atomic>
+
+#ifndef __GLIBC__
+#error "ENTITYBLOCK_ALLOC_STATS replaces the glibc allocator, it is not supported on this platform"
+#endif
+
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *__libc_calloc(size_t count, size_t size);
+extern "C" void *__libc_realloc(void *pointer, size_t size);
+extern "C" void *__libc_memalign(size_t alignment, size_t size);
+extern "C" void __libc_free(void *pointer);
+
+thread_local int currentPhase = phaseOther;
+
+//Zero initialized before any allocation can happen, the functions below must not allocate themselves
+static std::atomic<long long> allocationCount[phaseCount];
+static std::atomic<long long> allocatedBytes[phaseCount];
+static std::atomic<long long> peakLive[phaseCount];
+static std::atomic<long long> liveBytes;
+
+static void allocated(void *pointer)
+{
+    if(!pointer)
+        return;
+    long long size = malloc_usable_size(pointer);
+    int phase = currentPhase;
+    allocationCount[phase].fetch_add(1, std::memory_order_relaxed);
+    allocatedBytes[phase].fetch_add(size, std::memory_order_relaxed);
+    long long live = liveBytes.fetch_add(size, std::memory_order_relaxed)+size;
+    long long peak = peakLive[phase].load(std::memory_order_relaxed);
+    while(live>peak && !peakLive[phase].compare_exchange_weak(peak, live, std::memory_order_relaxed))
+        ;
+}
+
+static void released(void *pointer)
+{
+    if(pointer)
+        liveBytes.fetch_sub(malloc_usable_size(pointer), std::memory_order_relaxed);
+}
+
+//The program's own allocator functions replace the ones of glibc for all libraries, also for Qt
+extern "C" void *malloc(size_t size) __THROW
+{
+    void *pointer = __libc_malloc(size);
+    allocated(pointer);
+    return pointer;
+}
+
+extern "C" void *calloc(size_t count, size_t size) __THROW
+{
+    void *pointer = __libc_calloc(count, size);
+    allocated(pointer);
+    return pointer;
+}
+
+extern "C" void *realloc(void *pointer, size_t size) __THROW
+{
+    long long oldSize = pointer?malloc_usable_size(pointer):0;
+    void *result = __libc_realloc(pointer, size);
+    if(!result && size>0)
+        return result; //failed, pointer is still valid and counted
+    liveBytes.fetch_sub(oldSize, std::memory_order_relaxed);
+    allocated(result);
+    return result;
+}
+
+extern "C" void *memalign(size_t alignment, size_t size) __THROW
+{
+    void *pointer = __libc_memalign(alignment, size);
+    allocated(pointer);
+    return pointer;
+}
+
+extern "C" void *aligned_alloc(size_t alignment, size_t size) __THROW
+{
+    return memalign(alignment, size);
+}
+
+extern "C" int posix_memalign(void **result, size_t alignment, size_t size) __THROW
+{
+    void *pointer = __libc_memalign(alignment, size);
+    if(!pointer)
+        return ENOMEM;
+    allocated(pointer);
+    *result = pointer;
+    return 0;
+}
+
+extern "C" void free(void *pointer) __THROW
+{
+    released(pointer);
+    __libc_free(pointer);
+}
+
+bool AllocStats::enabled()
+{
+    return true;
+}
+
+AllocStats::Counters AllocStats::counters(phase_t phase)
+{
+    Counters c;
+    c.allocations = allocationCount[phase].load();
+    c.bytes = allocatedBytes[phase].load();
+    c.peakLive = peakLive[phase].load();
+    return c;
+}
+
+#else
+
+bool AllocStats::enabled()
+{
+    return false;
+}
+
+AllocStats::Counters AllocStats::counters(phase_t)
+{
+    Counters c;
+    c.allocations = c.bytes = c.peakLive = 0;
+    return c;
+}
+
+#endif
+
+void AllocStats::report()
+{
+    if(!enabled())
+    {
+        fprintf(stderr, "Allocation statistics are not available, build with ENTITYBLOCK_ALLOC_STATS\n");
+        return;
+    }
+    fprintf(stderr, "%-10s %14s %16s %16s\n", "phase", "allocations", "bytes", "peak live bytes");
+    for(int i=0; i<phaseCount; i++)
+    {
+        Counters c = counters(phase_t(i));
+        fprintf(stderr, "%-10s %14lld %16lld %16lld\n", phase_names[i], c.allocations, c.bytes, c.peakLive);
+    }
+}
+
+bool AllocStats::writeJson(QString fileName)
+{
+    QJsonObject phases;
+    for(int i=0; i<phaseCount; i++)
+    {
+        Counters c = counters(phase_t(i));
+        QJsonObject phase;
+        phase.insert("allocations", double(c.allocations));
+        phase.insert("bytes", double(c.bytes));
+        phase.insert("peakLiveBytes", double(c.peakLive));
+        phases.insert(phase_names[i], phase);
+    }
+    QJsonObject root;
+    root.insert("allocationStats", enabled());
+    root.insert("phases", phases);
+    if(!SvgWriter::publish(fileName, QJsonDocument(root).toJson()))
+    {
+        fprintf(stderr, "Could not write %s\n", fileName.toLocal8Bit().data());
+        return false;
+    }
+    return true;
+}
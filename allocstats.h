@@ -0,0 +1,105 @@
+/**
+ *  This program creates an SVG (Scalable Vector Graphics) symbol out of
+ *  a VHDL entity
+ *
+ *  Copyright (C) 2019  Frans Schreuder info@schreuderelectronics.com
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef ALLOCSTATS_H
+#define ALLOCSTATS_H
+
+#include <QString>
+
+///Phases of converting an entity, allocations are counted per phase.
+typedef enum{phaseOther, phaseRead, phaseParse, phaseClassify, phaseMeasure, phasePaint, phaseWrite, phaseCount} phase_t;
+const char phase_names[][16]={"other", "read", "parse", "classify", "measure", "paint", "write"};
+
+#ifdef ENTITYBLOCK_ALLOC_STATS
+///Phase of the current thread, set by PhaseScope
+extern thread_local int currentPhase;
+#endif
+
+/**
+ * @brief PhaseScope attributes the allocations of the current thread to phase until it goes out of scope,
+ * then the phase of the enclosing scope applies again. Does nothing unless built with ENTITYBLOCK_ALLOC_STATS.
+ */
+class PhaseScope
+{
+
+public:
+#ifdef ENTITYBLOCK_ALLOC_STATS
+    PhaseScope(phase_t phase)
+    {
+        previous = currentPhase;
+        currentPhase = phase;
+    }
+    ~PhaseScope()
+    {
+        currentPhase = previous;
+    }
+
+private:
+    int previous;
+#else
+    PhaseScope(phase_t)
+    {
+    }
+#endif
+};
+
+/**
+ * @brief AllocStats counts the heap allocations of all threads per phase: number of allocations, allocated bytes and
+ * the highest number of live bytes while a thread was in the phase. Counting is compiled in with the CMake option
+ * ENTITYBLOCK_ALLOC_STATS (qmake: CONFIG+=alloc_stats), it replaces malloc, calloc, realloc and free, which also
+ * catches operator new and the containers of Qt. Without it, enabled() is false and all counters are 0.
+ */
+class AllocStats
+{
+
+public:
+    ///Counters of one phase
+    struct Counters
+    {
+        long long allocations;
+        long long bytes;
+        long long peakLive; ///live bytes of the whole program, the highest seen during an allocation in this phase
+    };
+
+    /**
+     * @brief enabled true if the program was built with allocation counting
+     */
+    static bool enabled();
+
+    /**
+     * @brief counters current counters of phase
+     */
+    static Counters counters(phase_t phase);
+
+    /**
+     * @brief report writes a table with the counters of every phase to stderr
+     */
+    static void report();
+
+    /**
+     * @brief writeJson writes the counters of every phase as JSON object, keyed by phase name
+     * @param fileName file to write, - for stdout
+     * @return false if the file could not be written
+     */
+    static bool writeJson(QString fileName);
+};
+
+#endif // ALLOCSTATS_H
@@ -0,0 +1,167 @@
+/**
+ *  This program creates an SVG (Scalable Vector Graphics) symbol out of
+ *  a VHDL entity
+ *
+ *  Copyright (C) 2019  Frans Schreuder info@schreuderelectronics.com
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "archive.h"
+#include <QBuffer>
+#include <string.h>
+
+GzipWriter::GzipWriter(QIODevice *device)
+{
+    this->device = device;
+    closed = false;
+    memset(&stream, 0, sizeof(stream));
+    //15+16: gzip header instead of zlib
+    initialized = deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15+16, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+}
+
+GzipWriter::~GzipWriter()
+{
+    if(initialized)
+        deflateEnd(&stream);
+}
+
+bool GzipWriter::deflateTo(int flush)
+{
+    char out[16384];
+    do
+    {
+        stream.next_out = reinterpret_cast<Bytef*>(out);
+        stream.avail_out = sizeof(out);
+        int ret = deflate(&stream, flush);
+        if(ret == Z_STREAM_ERROR)
+            return false;
+        qint64 have = sizeof(out) - stream.avail_out;
+        if(have > 0 && device->write(out, have) != have)
+            return false;
+    } while(stream.avail_out == 0);
+    return true;
+}
+
+bool GzipWriter::write(const QByteArray &data)
+{
+    if(closed || !initialized)
+        return false;
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.constData()));
+    stream.avail_in = data.size();
+    return deflateTo(Z_NO_FLUSH);
+}
+
+bool GzipWriter::close()
+{
+    if(closed)
+        return initialized;
+    closed = true;
+    if(!initialized)
+        return false;
+    stream.next_in = NULL;
+    stream.avail_in = 0;
+    return deflateTo(Z_FINISH);
+}
+
+QByteArray GzipWriter::compress(const QByteArray &data)
+{
+    QByteArray result;
+    QBuffer buffer(&result);
+    buffer.open(QIODevice::WriteOnly);
+    GzipWriter gzip(&buffer);
+    if(!gzip.write(data) || !gzip.close())
+        return QByteArray();
+    return result;
+}
+
+TarWriter::TarWriter(QIODevice *device, bool compressed)
+{
+    this->device = device;
+    gzip = compressed?new GzipWriter(device):NULL;
+    modificationTime = 0;
+}
+
+TarWriter::~TarWriter()
+{
+    delete gzip;
+}
+
+bool TarWriter::writeData(const QByteArray &data)
+{
+    if(gzip)
+        return gzip->write(data);
+    return device->write(data) == data.size();
+}
+
+///Writes value as a zero padded octal number of size-1 digits followed by a NUL.
+static void tarNumber(char *field, int size, qint64 value)
+{
+    QByteArray digits = QByteArray::number(value, 8).rightJustified(size-1, '0');
+    memcpy(field, digits.constData(), size-1);
+    field[size-1] = 0;
+}
+
+bool TarWriter::addFile(QString name, const QByteArray &data)
+{
+    QByteArray path = name.toUtf8();
+    QByteArray prefix;
+    if(path.size() > 100) //ustar: split long paths in a prefix (directory) and a name
+    {
+        int slash = path.lastIndexOf('/');
+        while(slash > 155)
+            slash = path.lastIndexOf('/', slash-1);
+        if(slash <= 0 || path.size()-slash-1 > 100)
+            return false;
+        prefix = path.left(slash);
+        path = path.mid(slash+1);
+    }
+
+    char header[512];
+    memset(header, 0, sizeof(header));
+    memcpy(header, path.constData(), path.size());
+    tarNumber(header+100, 8, 0644); //mode
+    tarNumber(header+108, 8, 0); //uid
+    tarNumber(header+116, 8, 0); //gid
+    tarNumber(header+124, 12, data.size());
+    tarNumber(header+136, 12, modificationTime);
+    header[156] = '0'; //regular file
+    memcpy(header+257, "ustar", 6);
+    memcpy(header+263, "00", 2);
+    memcpy(header+345, prefix.constData(), prefix.size());
+
+    memset(header+148, ' ', 8); //the checksum is calculated with spaces in its own field
+    unsigned int checksum = 0;
+    for(int i=0; i<512; i++)
+        checksum += static_cast<unsigned char>(header[i]);
+    tarNumber(header+148, 7, checksum);
+
+    int padding = (512 - data.size()%512)%512;
+    return writeData(QByteArray(header, 512)) &&
+           writeData(data) &&
+           writeData(QByteArray(padding, 0));
+}
+
+void TarWriter::setModificationTime(qint64 secsSinceEpoch)
+{
+    modificationTime = secsSinceEpoch;
+}
+
+bool TarWriter::close()
+{
+    bool ok = writeData(QByteArray(1024, 0)); //two empty blocks mark the end of the archive
+    if(gzip)
+        ok = gzip->close() && ok;
+    return ok;
+}
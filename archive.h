@@ -0,0 +1,115 @@
+/**
+ *  This program creates an SVG (Scalable Vector Graphics) symbol out of
+ *  a VHDL entity
+ *
+ *  Copyright (C) 2019  Frans Schreuder info@schreuderelectronics.com
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef ARCHIVE_H
+#define ARCHIVE_H
+
+#include <QIODevice>
+#include <QByteArray>
+#include <QString>
+#include <zlib.h>
+
+/**
+ * @brief GzipWriter compresses a stream of data in gzip format while it is written to a QIODevice.
+ */
+class GzipWriter
+{
+
+public:
+    /**
+     * @brief GzipWriter Constructor
+     * @param device open device that receives the compressed data
+     */
+    GzipWriter(QIODevice *device);
+    ~GzipWriter();
+
+    /**
+     * @brief write compresses data and writes whatever zlib produced so far to the device.
+     * @return false if the device could not be written or zlib could not be initialized
+     */
+    bool write(const QByteArray &data);
+
+    /**
+     * @brief close flushes the remaining compressed data and the gzip trailer.
+     * @return false if the device could not be written
+     */
+    bool close();
+
+    /**
+     * @brief compress gzips a complete buffer, e.g. to turn a .svg into a .svgz file
+     * @return the compressed data, empty if zlib could not be initialized
+     */
+    static QByteArray compress(const QByteArray &data);
+
+private:
+    bool deflateTo(int flush);
+
+    QIODevice *device;
+    z_stream stream;
+    bool initialized; ///false if zlib could not allocate its state, every write then fails
+    bool closed;
+};
+
+/**
+ * @brief TarWriter writes files into a single (optionally gzip compressed) tar archive, in one sequential stream.
+ */
+class TarWriter
+{
+
+public:
+    /**
+     * @brief TarWriter Constructor
+     * @param device open device that receives the archive
+     * @param compressed true for a .tar.gz archive
+     */
+    TarWriter(QIODevice *device, bool compressed);
+    ~TarWriter();
+
+    /**
+     * @brief addFile appends one regular file to the archive
+     * @param name path of the file inside the archive
+     * @param data contents of the file
+     * @return false if the name is too long, the device could not be written or zlib could not be initialized
+     */
+    bool addFile(QString name, const QByteArray &data);
+
+    /**
+     * @brief setModificationTime time stamp of the files added after this call. It is 0 (1970) by default, not the
+     * current time, so the same input gives the same archive.
+     * @param secsSinceEpoch seconds since 1970-01-01 UTC
+     */
+    void setModificationTime(qint64 secsSinceEpoch);
+
+    /**
+     * @brief close writes the end-of-archive marker
+     * @return false if the device could not be written
+     */
+    bool close();
+
+private:
+    bool writeData(const QByteArray &data);
+
+    QIODevice *device;
+    GzipWriter *gzip;
+    qint64 modificationTime;
+};
+
+#endif // ARCHIVE_H
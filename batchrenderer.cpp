@@ -0,0 +1,460 @@
+/**
+ *  This program creates an SVG (Scalable Vector Graphics) symbol out of
+ *  a VHDL entity
+ *
+ *  Copyright (C) 2019  Frans Schreuder info@schreuderelectronics.com
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "batchrenderer.h"
+#include "entityblock.h"
+#include "svgwriter.h"
+#include "archive.h"
+#include "entitymodel.h"
+#include "catalog.h"
+#include "allocstats.h"
+#include <stdio.h>
+#include <QDir>
+#include <QFile>
+#include <QBuffer>
+#include <QVector>
+#include <QRunnable>
+#include <QThreadPool>
+#include <QAtomicInt>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QHash>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QSet>
+#include <QPair>
+#include <algorithm>
+
+///State shared by all tasks of one batch.
+struct RenderContext
+{
+    const EntityBlock *prototype; ///colors and dimensions, copied for every entity so QSettings is only read once
+    QString outputDir;
+    SvgWriter *writer;
+    EntityModelExport *modelExport;
+    Catalog *catalog;
+    QThreadPool *pool;
+    QAtomicInt failures;
+    QStringList fileNames;
+    QMutex targetMutex;
+    QHash<QString, QPair<int, int> > targets; ///symbol path to the last entity (file, entity) that renders it
+};
+
+///Parses one entity out of a file and hands the rendered image to the writer.
+class EntityTask : public QRunnable
+{
+public:
+    EntityTask(RenderContext *context, QString fileName, int fileIndex, int entityIndex, QByteArray data, int begin, int end)
+    {
+        this->context = context;
+        this->fileName = fileName;
+        this->fileIndex = fileIndex;
+        this->entityIndex = entityIndex;
+        this->data = data;
+        this->begin = begin;
+        this->end = end;
+    }
+
+    void run() override
+    {
+        context->writer->entityStarted(fileIndex, entityIndex);
+        render();
+        context->writer->entityDone(fileIndex, entityIndex); //also after a failure, the archive must not wait for it
+    }
+
+private:
+    void render()
+    {
+        EntityBlock block(*context->prototype);
+        QByteArray chunk = QByteArray::fromRawData(data.constData()+begin, end-begin); //no copy, data holds the file
+        QBuffer buffer(&chunk);
+        buffer.open(QIODevice::ReadOnly);
+        if(!block.loadDevice(buffer) || block.name().isEmpty())
+        {
+            fprintf(stderr, "Could not read an entity from %s (entity %d)\n", fileName.toLocal8Bit().data(), entityIndex+1);
+            context->failures.ref();
+            return;
+        }
+        if(context->modelExport)
+            context->modelExport->add(fileIndex, entityIndex, block);
+        QString target = context->outputDir.isEmpty()?block.name():QDir(context->outputDir).filePath(block.name());
+        checkTarget(block.svgPath(target));
+        if(!block.saveSvg(target, context->writer, fileIndex, entityIndex))
+        {
+            context->failures.ref();
+            return;
+        }
+        if(context->catalog)
+            context->catalog->add(fileIndex, entityIndex, block, block.svgPath(target));
+    }
+
+    ///Reports entities with the same name, the writer keeps the symbol of the one given last
+    void checkTarget(QString path)
+    {
+        QMutexLocker locker(&context->targetMutex);
+        QPair<int, int> key(fileIndex, entityIndex);
+        if(context->targets.contains(path))
+        {
+            QPair<int, int> kept = qMax(key, context->targets.value(path));
+            fprintf(stderr, "%s is rendered from more than one entity, the one in %s is kept\n", path.toLocal8Bit().data(),
+                    context->fileNames.value(kept.first).toLocal8Bit().data());
+            key = kept;
+        }
+        context->targets.insert(path, key);
+    }
+
+    RenderContext *context;
+    QString fileName;
+    int fileIndex;
+    int entityIndex;
+    QByteArray data;
+    int begin;
+    int end;
+};
+
+///Reads one file and splits it at the entity boundaries, so the entities of a large file are rendered in parallel.
+class FileTask : public QRunnable
+{
+public:
+    FileTask(RenderContext *context, int fileIndex, QString fileName)
+    {
+        this->context = context;
+        this->fileIndex = fileIndex;
+        this->fileName = fileName;
+    }
+
+    void run() override
+    {
+        QFile file;
+        QByteArray data;
+        {
+            PhaseScope scope(phaseRead);
+            if(EntityBlock::openInput(file, fileName))
+                data = file.readAll();
+        }
+        QVector<int> ends = EntityBlock::entityBoundaries(data);
+        context->writer->setEntityCount(fileIndex, ends.size());
+        if(ends.isEmpty())
+        {
+            fprintf(stderr, "Could not read an entity from %s\n", fileName.toLocal8Bit().data());
+            context->failures.ref();
+            return;
+        }
+        //Every chunk also holds the lines before its entity, so the libraries stay with the entity
+        //Before the files that are not read yet, so the entities reach the writer roughly in the order of the archive
+        for(int i=1; i<ends.size(); i++)
+            context->pool->start(new EntityTask(context, fileName, fileIndex, i, data, ends[i-1], ends[i]), 1);
+        EntityTask(context, fileName, fileIndex, 0, data, 0, ends[0]).run(); //the first one right here
+    }
+
+private:
+    RenderContext *context;
+    int fileIndex;
+    QString fileName;
+};
+
+///Outcome of checking one file.
+struct CheckResult
+{
+    QByteArray report;
+    int entities;
+    int ports;
+    int errors;
+    int warnings;
+};
+
+///Parses every entity of one file without painting and reports what is wrong with it.
+class CheckTask : public QRunnable
+{
+public:
+    CheckTask(QString fileName, CheckResult *result)
+    {
+        this->fileName = fileName;
+        this->result = result;
+    }
+
+    void run() override
+    {
+        result->entities = result->ports = result->errors = result->warnings = 0;
+        QFile file;
+        if(!EntityBlock::openInput(file, fileName))
+        {
+            result->report = fileName.toLocal8Bit() + ": error: could not open file\n";
+            result->errors++;
+            return;
+        }
+        QByteArray data;
+        {
+            PhaseScope scope(phaseRead);
+            data = file.readAll();
+        }
+        QVector<int> ends = EntityBlock::entityBoundaries(data);
+        ends.push_back(data.size()); //the rest of the file, to catch an entity that is never closed
+        int begin = 0;
+        int lineOffset = 0;
+        for(int i=0; i<ends.size(); i++)
+        {
+            QByteArray chunk = QByteArray::fromRawData(data.constData()+begin, ends[i]-begin);
+            QBuffer buffer(&chunk);
+            buffer.open(QIODevice::ReadOnly);
+            EntityBlock block; //no settings, nothing is painted
+            if(block.loadDevice(buffer))
+            {
+                result->entities++;
+                result->ports += block.portList().size();
+            }
+            QList<Diagnostic> diagnostics = block.diagnostics();
+            for(int d=0; d<diagnostics.size(); d++)
+            {
+                result->report += fileName.toLocal8Bit() + ":" + QByteArray::number(diagnostics[d].line+lineOffset) +
+                        (diagnostics[d].error?": error: ":": warning: ") + diagnostics[d].message.toLocal8Bit() + "\n";
+                if(diagnostics[d].error)
+                    result->errors++;
+                else
+                    result->warnings++;
+            }
+            lineOffset += chunk.count('\n');
+            begin = ends[i];
+        }
+    }
+
+private:
+    QString fileName;
+    CheckResult *result;
+};
+
+BatchRenderer::BatchRenderer(QSettings* s, symbol_style_t style, QString outputDir, int jobs)
+{
+    settings = s;
+    symbolStyle = style;
+    this->outputDir = outputDir;
+    this->jobs = jobs;
+    compressed = false;
+    compactPrecision = -1;
+    geometry = false;
+    modelExport = NULL;
+    catalog = NULL;
+}
+
+void BatchRenderer::setCompressed(bool compressed)
+{
+    this->compressed = compressed;
+}
+
+void BatchRenderer::setCompactPrecision(int precision)
+{
+    compactPrecision = precision;
+}
+
+void BatchRenderer::setGeometrySidecar(bool enabled)
+{
+    geometry = enabled;
+}
+
+void BatchRenderer::setArchive(QString fileName)
+{
+    archiveName = fileName;
+}
+
+void BatchRenderer::setModelExport(EntityModelExport *modelExport)
+{
+    this->modelExport = modelExport;
+}
+
+void BatchRenderer::setCatalog(Catalog *catalog)
+{
+    this->catalog = catalog;
+}
+
+bool BatchRenderer::render(QStringList fileNames)
+{
+    if(archiveName.isEmpty() && !QDir().mkpath(outputDir))
+    {
+        fprintf(stderr, "Could not create directory %s\n", outputDir.toLocal8Bit().data());
+        return false;
+    }
+
+    //The global pool, so the threads that measure very wide entities come out of the same -j threads
+    QThreadPool &pool = *QThreadPool::globalInstance();
+    if(jobs > 0)
+        pool.setMaxThreadCount(jobs);
+    //The archive gets the time of the newest input instead of the current time, so it only changes with the inputs
+    qint64 newestInput = 0;
+    for(int i=0; i<fileNames.size() && !archiveName.isEmpty(); i++)
+        if(fileNames[i] != "-")
+            newestInput = qMax(newestInput, QFileInfo(fileNames[i]).lastModified().toSecsSinceEpoch());
+    SvgWriter writer(4*pool.maxThreadCount());
+    if(!archiveName.isEmpty() && !writer.setArchive(archiveName, newestInput))
+    {
+        fprintf(stderr, "Could not create %s\n", archiveName.toLocal8Bit().data());
+        return false;
+    }
+    writer.start();
+
+    //QSettings is only read here, in the main thread
+    EntityBlock prototype("", "", settings, symbolStyle, compressed, compactPrecision);
+    prototype.setGeometrySidecar(geometry);
+    RenderContext context;
+    context.prototype = &prototype;
+    context.outputDir = outputDir;
+    context.writer = &writer;
+    context.modelExport = modelExport;
+    context.catalog = catalog;
+    context.pool = &pool;
+    context.fileNames = fileNames;
+    for(int i=0; i<fileNames.size(); i++)
+        pool.start(new FileTask(&context, i, fileNames[i]));
+    pool.waitForDone();
+    writer.finish();
+    if(catalog) //the writer reports the symbols it could not write only now
+        catalog->removeSymbols(writer.failedPaths());
+
+    return context.failures.load()==0 && writer.failures()==0;
+}
+
+bool BatchRenderer::renderFrames(QStringList fileNames)
+{
+    QFile out;
+    if(!out.open(stdout, QIODevice::WriteOnly))
+        return false;
+
+    bool ok = true;
+    for(int i=0; i<fileNames.size(); i++)
+    {
+        QFile file;
+        if(!EntityBlock::openInput(file, fileNames[i]))
+        {
+            fprintf(stderr, "Could not open %s\n", fileNames[i].toLocal8Bit().data());
+            ok = false;
+            continue;
+        }
+        for(int entity=0; ; entity++)
+        {
+            EntityBlock block("", "", settings, symbolStyle, compressed, compactPrecision);
+            if(!block.loadDevice(file))
+                break; //no more entities in this file
+            if(modelExport)
+                modelExport->add(i, entity, block);
+            QByteArray svg = block.renderSvg();
+            if(compressed)
+                svg = GzipWriter::compress(svg);
+            if(svg.isEmpty())
+            {
+                fprintf(stderr, "Could not compress %s\n", block.name().toLocal8Bit().data());
+                ok = false;
+                continue;
+            }
+            out.write(block.name().toUtf8() + " " + QByteArray::number(svg.size()) + "\n");
+            out.write(svg);
+            out.write("\n");
+            out.flush(); //hand every frame to the next process in the pipe right away
+        }
+    }
+    return ok;
+}
+
+bool BatchRenderer::check(QStringList fileNames)
+{
+    QThreadPool pool;
+    if(jobs > 0)
+        pool.setMaxThreadCount(jobs);
+    QVector<CheckResult> results(fileNames.size());
+    for(int i=0; i<fileNames.size(); i++)
+        pool.start(new CheckTask(fileNames[i], &results[i]));
+    pool.waitForDone();
+
+    CheckResult total;
+    total.entities = total.ports = total.errors = total.warnings = 0;
+    for(int i=0; i<results.size(); i++) //report in the order of the arguments
+    {
+        fputs(results[i].report.constData(), stderr);
+        total.entities += results[i].entities;
+        total.ports += results[i].ports;
+        total.errors += results[i].errors;
+        total.warnings += results[i].warnings;
+    }
+    printf("%d files, %d entities, %d ports, %d errors, %d warnings\n",
+           int(fileNames.size()), total.entities, total.ports, total.errors, total.warnings);
+    return total.errors==0;
+}
+
+///64 bit FNV-1a hash, unlike qHash it is the same on every machine and every run.
+static quint64 stableHash(const QByteArray &data)
+{
+    quint64 hash = 14695981039346656037ULL;
+    for(int i=0; i<data.size(); i++)
+    {
+        hash ^= uchar(data[i]);
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+///Sorts the heaviest files first, so the small files fill up what is left at the end.
+static bool heavierFirst(const QPair<qint64, QString> &a, const QPair<qint64, QString> &b)
+{
+    if(a.first != b.first)
+        return a.first > b.first;
+    return a.second < b.second;
+}
+
+QStringList BatchRenderer::selectShard(QStringList fileNames, int index, int count)
+{
+    if(count <= 1)
+        return fileNames;
+
+    QList<QPair<qint64, QString> > files;
+    qint64 total = 0;
+    for(int i=0; i<fileNames.size(); i++)
+    {
+        qint64 size = fileNames[i]=="-"?0:QFileInfo(fileNames[i]).size();
+        files.push_back(qMakePair(size+1, fileNames[i])); //+1: also spread empty files
+        total += size+1;
+    }
+    std::sort(files.begin(), files.end(), heavierFirst);
+
+    qint64 capacity = total/count + total/(20*count) + 1; //5% slack keeps most files on their preferred shard
+    QVector<qint64> load(count, 0);
+    QSet<QString> selected;
+    for(int f=0; f<files.size(); f++)
+    {
+        //rank the shards on the hash of file name and shard number (rendezvous hashing)
+        QByteArray name = files[f].second.toUtf8();
+        QList<QPair<quint64, int> > ranking;
+        for(int s=0; s<count; s++)
+            ranking.push_back(qMakePair(stableHash(name + "#" + QByteArray::number(s)), s));
+        std::sort(ranking.begin(), ranking.end());
+        int shard = -1;
+        for(int r=count-1; r>=0 && shard<0; r--)
+            if(load[ranking[r].second] + files[f].first <= capacity)
+                shard = ranking[r].second;
+        if(shard < 0) //does not fit anywhere, take the emptiest shard
+            shard = int(std::min_element(load.begin(), load.end()) - load.begin());
+        load[shard] += files[f].first;
+        if(shard == index)
+            selected.insert(files[f].second);
+    }
+
+    QStringList result;
+    for(int i=0; i<fileNames.size(); i++)
+        if(selected.contains(fileNames[i]))
+            result.push_back(fileNames[i]);
+    return result;
+}
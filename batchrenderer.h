@@ -0,0 +1,131 @@
+/**
+ *  This program creates an SVG (Scalable Vector Graphics) symbol out of
+ *  a VHDL entity
+ *
+ *  Copyright (C) 2019  Frans Schreuder info@schreuderelectronics.com
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef BATCHRENDERER_H
+#define BATCHRENDERER_H
+
+#include <QString>
+#include <QStringList>
+#include <QSettings>
+#include "entityblock.h"
+
+class EntityModelExport;
+class Catalog;
+
+/**
+ * @brief BatchRenderer converts many VHDL files at once. Files are parsed and painted on a thread pool,
+ * the resulting images are written by a separate SvgWriter thread.
+ */
+class BatchRenderer
+{
+
+public:
+    /**
+     * @brief BatchRenderer Constructor
+     * @param s colors and dimensions, passed on to every EntityBlock
+     * @param style full, minimal or compact symbols
+     * @param outputDir directory in which the .svg files are stored, named after the entity
+     * @param jobs number of render threads, 0 for one per core
+     */
+    BatchRenderer(QSettings* s, symbol_style_t style, QString outputDir, int jobs=0);
+
+    /**
+     * @brief render converts all files
+     * @param fileNames VHDL files to convert
+     * @return false if any file could not be read or written
+     */
+    bool render(QStringList fileNames);
+
+    /**
+     * @brief renderFrames converts every entity in the files and writes them to stdout, one frame per entity:
+     * a line "<entity> <size>", followed by size bytes of .svg data and a newline.
+     * @param fileNames VHDL files to convert, - reads stdin
+     * @return false if any file could not be read
+     */
+    bool renderFrames(QStringList fileNames);
+
+    /**
+     * @brief check only parses the files, without painting or loading fonts. Malformed declarations are
+     * reported on stderr as "file:line: error: message", a summary with entity and port counts on stdout.
+     * @param fileNames VHDL files to check
+     * @return false if any error was found
+     */
+    bool check(QStringList fileNames);
+
+    /**
+     * @brief selectShard selects the files that shard index out of count has to convert.
+     * The shards are balanced on file size. Every file prefers the shard with the highest hash of its name and
+     * the shard number, and gets it unless that shard is already full. So a file ends up on the same shard on
+     * every run, also when other files are added or removed, as long as the shards stay balanced.
+     * @param fileNames all input files, in any order
+     * @param index shard to select, 0 to count-1
+     * @param count number of shards
+     * @return the files of shard index, in the order of fileNames
+     */
+    static QStringList selectShard(QStringList fileNames, int index, int count);
+
+    /**
+     * @brief setCompressed store the symbols as gzip compressed .svgz files
+     */
+    void setCompressed(bool compressed);
+
+    /**
+     * @brief setCompactPrecision write minified symbols with coordinates rounded to precision decimals, -1 to disable
+     */
+    void setCompactPrecision(int precision);
+
+    /**
+     * @brief setGeometrySidecar also write a .json file with the layout next to every symbol
+     */
+    void setGeometrySidecar(bool enabled);
+
+    /**
+     * @brief setArchive store all symbols in a single .tar or .tar.gz file instead of separate files.
+     * The output directory is then used as directory inside the archive. The symbols are stored in the order of the
+     * input files and of the entities within them, with the time of the newest input file, so the same inputs give
+     * the same archive.
+     */
+    void setArchive(QString fileName);
+
+    /**
+     * @brief setModelExport every parsed entity is also added to modelExport
+     */
+    void setModelExport(EntityModelExport *modelExport);
+
+    /**
+     * @brief setCatalog every rendered symbol is also added to catalog
+     */
+    void setCatalog(Catalog *catalog);
+
+private:
+    QSettings *settings;
+    symbol_style_t symbolStyle;
+    QString outputDir;
+    int jobs;
+    bool compressed;
+    int compactPrecision;
+    bool geometry;
+    QString archiveName;
+    EntityModelExport *modelExport;
+    Catalog *catalog;
+};
+
+#endif // BATCHRENDERER_H
@@ -0,0 +1,185 @@
+/**
+ *  This program creates an SVG (Scalable Vector Graphics) symbol out of
+ *  a VHDL entity
+ *
+ *  Copyright (C) 2019  Frans Schreuder info@schreuderelectronics.com
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "catalog.h"
+#include "entityblock.h"
+#include "svgwriter.h"
+#include <QDir>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QFile>
+#include <QJsonDocument>
+#include <QMutexLocker>
+#include <QSet>
+
+void Catalog::add(int file, int entity, const EntityBlock &block, QString svgPath)
+{
+    Entry e;
+    e.name = block.name();
+    e.svg = svgPath;
+    QList<Port> ports = block.portList();
+    QList<Port> generics = block.genericList();
+    for(int i=0; i<ports.size(); i++)
+        e.ports.push_back(ports[i].name);
+    for(int i=0; i<generics.size(); i++)
+        e.generics.push_back(generics[i].name);
+    QMutexLocker locker(&mutex);
+    entryMap.insert(qMakePair(file, entity), e);
+}
+
+void Catalog::removeSymbols(const QStringList &svgPaths)
+{
+    QSet<QString> removed;
+    for(int i=0; i<svgPaths.size(); i++)
+        removed.insert(svgPaths[i]);
+    QMutexLocker locker(&mutex);
+    QMutableMapIterator<QPair<int, int>, Entry> it(entryMap);
+    while(it.hasNext())
+    {
+        it.next();
+        if(removed.contains(it.value().svg))
+            it.remove();
+    }
+}
+
+QList<Catalog::Entry> Catalog::entries() const
+{
+    QMutexLocker locker(&mutex);
+    //Entities with the same name share a symbol, which holds the last of them
+    QList<Entry> all;
+    QSet<QString> seen;
+    QMapIterator<QPair<int, int>, Entry> it(entryMap);
+    it.toBack();
+    while(it.hasPrevious())
+    {
+        it.previous();
+        if(!seen.contains(it.value().svg))
+        {
+            seen.insert(it.value().svg);
+            all.prepend(it.value());
+        }
+    }
+    return all;
+}
+
+bool Catalog::writeManifest(QString fileName)
+{
+    QDir dir = QFileInfo(fileName).absoluteDir();
+    QList<Entry> all = entries();
+    QJsonArray manifest;
+    for(int i=0; i<all.size(); i++)
+    {
+        QJsonObject o;
+        o["entity"] = all[i].name;
+        o["svg"] = dir.relativeFilePath(QFileInfo(all[i].svg).absoluteFilePath());
+        o["ports"] = QJsonArray::fromStringList(all[i].ports);
+        o["generics"] = QJsonArray::fromStringList(all[i].generics);
+        manifest.append(o);
+    }
+    return SvgWriter::publish(fileName, QJsonDocument(manifest).toJson(QJsonDocument::Indented));
+}
+
+static QStringList toStringList(const QJsonValue &value)
+{
+    QStringList list;
+    QJsonArray array = value.toArray();
+    for(int i=0; i<array.size(); i++)
+        list.push_back(array[i].toString());
+    return list;
+}
+
+bool Catalog::loadManifest(QString fileName, int file)
+{
+    QFile f(fileName);
+    if(!f.open(QFile::ReadOnly))
+        return false;
+    QJsonParseError error;
+    QJsonDocument document = QJsonDocument::fromJson(f.readAll(), &error);
+    if(error.error != QJsonParseError::NoError || !document.isArray())
+        return false;
+    QDir dir = QFileInfo(fileName).absoluteDir();
+    QJsonArray manifest = document.array();
+    QMutexLocker locker(&mutex);
+    for(int i=0; i<manifest.size(); i++)
+    {
+        QJsonObject o = manifest[i].toObject();
+        Entry e;
+        e.name = o["entity"].toString();
+        e.svg = dir.absoluteFilePath(o["svg"].toString()); //the paths in a manifest are relative to the manifest
+        e.ports = toStringList(o["ports"]);
+        e.generics = toStringList(o["generics"]);
+        entryMap.insert(qMakePair(file, i), e);
+    }
+    return true;
+}
+
+static const char catalogHead[] =
+    "<!DOCTYPE html>\n"
+    "<html><head><meta charset=\"utf-8\"><title>Entity catalog</title>\n"
+    "<style>\n"
+    "body{font-family:sans-serif;margin:1em}\n"
+    "#q{width:100%;font-size:1.2em;padding:.3em;box-sizing:border-box}\n"
+    "#n{color:#666;margin:.5em 0}\n"
+    "main{display:flex;flex-wrap:wrap;gap:1em}\n"
+    "figure{margin:0;width:240px;content-visibility:auto;contain-intrinsic-size:240px 200px}\n"
+    "figure img{width:240px;height:180px;object-fit:contain}\n"
+    "figcaption{text-align:center;overflow-wrap:anywhere}\n"
+    "</style></head><body>\n"
+    "<input id=\"q\" type=\"search\" placeholder=\"Search entities, ports and generics\" autofocus>\n"
+    "<div id=\"n\"></div>\n"
+    "<main id=\"c\">\n";
+
+//The index holds [entity, ports, generics] per figure, in the same order as the figures.
+static const char catalogScript[] =
+    "var f=document.getElementById('c').children,q=document.getElementById('q'),n=document.getElementById('n');\n"
+    "var s=x.map(function(e){return e.join(' ').toLowerCase();});\n"
+    "function u(){var t=q.value.toLowerCase().split(/\\s+/).filter(Boolean),c=0;\n"
+    " for(var i=0;i<f.length;i++){var m=t.every(function(w){return s[i].indexOf(w)>=0;});f[i].hidden=!m;if(m)c++;}\n"
+    " n.textContent=c+' of '+f.length+' entities';}\n"
+    "q.addEventListener('input',u);u();\n";
+
+bool Catalog::write(QString fileName)
+{
+    QDir dir = QFileInfo(fileName).absoluteDir();
+    QList<Entry> all = entries();
+
+    QByteArray html(catalogHead);
+    QJsonArray index;
+    for(int i=0; i<all.size(); i++)
+    {
+        QString svg = dir.relativeFilePath(QFileInfo(all[i].svg).absoluteFilePath());
+        QString name = all[i].name.toHtmlEscaped();
+        html += "<figure><a href=\"" + svg.toHtmlEscaped().toUtf8() + "\"><img src=\"" + svg.toHtmlEscaped().toUtf8() +
+                "\" alt=\"" + name.toUtf8() + "\" loading=\"lazy\" decoding=\"async\"></a><figcaption>" +
+                name.toUtf8() + "</figcaption></figure>\n";
+        QJsonArray e;
+        e.append(all[i].name);
+        e.append(all[i].ports.join(" "));
+        e.append(all[i].generics.join(" "));
+        index.append(e);
+    }
+    html += "</main>\n<script>\nvar x=";
+    html += QJsonDocument(index).toJson(QJsonDocument::Compact).replace("</", "<\\/");
+    html += ";\n";
+    html += catalogScript;
+    html += "</script></body></html>\n";
+    return SvgWriter::publish(fileName, html);
+}
@@ -0,0 +1,101 @@
+/**
+ *  This program creates an SVG (Scalable Vector Graphics) symbol out of
+ *  a VHDL entity
+ *
+ *  Copyright (C) 2019  Frans Schreuder info@schreuderelectronics.com
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef CATALOG_H
+#define CATALOG_H
+
+#include <QString>
+#include <QStringList>
+#include <QList>
+#include <QMap>
+#include <QPair>
+#include <QMutex>
+
+class EntityBlock;
+
+/**
+ * @brief Catalog collects the rendered symbols of a batch and writes a static HTML page to browse them.
+ * The page holds a compact search index (entity, port and generic names) and thumbnails that are only
+ * loaded when they are scrolled into view, so it is interactive right away, however many entities there are.
+ * add() may be called from several threads.
+ */
+class Catalog
+{
+
+public:
+    ///One symbol in the catalog.
+    struct Entry
+    {
+        QString name;
+        QString svg; ///path of the symbol
+        QStringList ports;
+        QStringList generics;
+    };
+
+    /**
+     * @brief add adds a rendered entity to the catalog
+     * @param file index of the input file, the catalog is sorted on file and entity
+     * @param entity index of the entity within the file
+     * @param block entity that was rendered
+     * @param svgPath file the symbol was written to
+     */
+    void add(int file, int entity, const EntityBlock &block, QString svgPath);
+
+    /**
+     * @brief removeSymbols removes the entries of symbols that could not be written
+     * @param svgPaths paths as given to add
+     */
+    void removeSymbols(const QStringList &svgPaths);
+
+    /**
+     * @brief entries all entries, in file and entity order. Of the entries with the same symbol only the last is kept.
+     */
+    QList<Entry> entries() const;
+
+    /**
+     * @brief writeManifest writes all entries as JSON, so the catalogs of several runs can be merged later.
+     * Symbol paths are stored relative to the manifest.
+     * @param fileName JSON file to write
+     * @return false if the file could not be written
+     */
+    bool writeManifest(QString fileName);
+
+    /**
+     * @brief loadManifest adds the entries of a manifest written by writeManifest
+     * @param fileName JSON file to read
+     * @param file entries are sorted on this index first, then on their order in the manifest
+     * @return false if the file could not be read
+     */
+    bool loadManifest(QString fileName, int file);
+
+    /**
+     * @brief write writes the HTML page. Symbol paths are stored relative to the page.
+     * @param fileName HTML file to write
+     * @return false if the file could not be written
+     */
+    bool write(QString fileName);
+
+private:
+    QMap<QPair<int, int>, Entry> entryMap;
+    mutable QMutex mutex;
+};
+
+#endif // CATALOG_H
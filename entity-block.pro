@@ -27,9 +27,33 @@ DEFINES += QT_DEPRECATED_WARNINGS
 
 SOURCES += \
         main.cpp \
-        entityblock.cpp
+        entityblock.cpp \
+        svgwriter.cpp \
+        batchrenderer.cpp \
+        archive.cpp \
+        entitymodel.cpp \
+        structuralindex.cpp \
+        catalog.cpp \
+        svgminifier.cpp \
+        hierarchy.cpp \
+        allocstats.cpp
 
 HEADERS += \
-        entityblock.h
+        entityblock.h \
+        svgwriter.h \
+        batchrenderer.h \
+        archive.h \
+        entitymodel.h \
+        structuralindex.h \
+        catalog.h \
+        svgminifier.h \
+        hierarchy.h \
+        allocstats.h \
+        symbolstyle.h
+
+LIBS += -lz
+
+# qmake CONFIG+=alloc_stats counts allocations per phase for --stats
+alloc_stats: DEFINES += ENTITYBLOCK_ALLOC_STATS
 
 INSTALLS += TARGET
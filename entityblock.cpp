@@ -19,35 +19,61 @@
  */
 
 #include "entityblock.h"
+#include "svgwriter.h"
+#include "archive.h"
+#include "structuralindex.h"
+#include "svgminifier.h"
+#include "symbolstyle.h"
+#include "allocstats.h"
 #include <stdio.h>
 #include <QDebug>
 #include <QtSvg/QSvgGenerator>
 #include <QPainterPath>
 #include <QFile>
+#include <QBuffer>
+#include <QRunnable>
+#include <QThreadPool>
+#include <QSemaphore>
+#include <QAtomicInt>
+#include <QFontMetrics>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <string.h>
 
 Port::Port()
 {
     direction = in;
+    line = 0;
 }
 
-EntityBlock::EntityBlock(QString fileName, QString targetName, QSettings* s, bool simplifiedSymbol)
+EntityBlock::EntityBlock(QString fileName, QString targetName, QSettings* s, symbol_style_t style, bool compressed,
+                         int compactPrecision)
 {
     settings = s;
-    cComment = settings->value("Colors/comment",QColor(Qt::darkGreen)).value<QColor>();
-    cPortName = settings->value("Colors/portName",QColor(Qt::black)).value<QColor>();
-    cPortType = settings->value("Colors/portType",QColor(Qt::darkBlue)).value<QColor>();
-    cBackground = settings->value("Colors/background",QColor("#fffff3")).value<QColor>();
-    cHeader1 = settings->value("Colors/headerLeft",QColor("#014040")).value<QColor>();
-    cHeader2 = settings->value("Colors/headerRight",QColor("#7f7f7f")).value<QColor>();
-    cTitle = settings->value("Colors/title",QColor(Qt::white)).value<QColor>();
-    cBorder = settings->value("Colors/border",QColor("#235676")).value<QColor>();
-    cPorts = settings->value("Colors/port",QColor("#235676")).value<QColor>();
-    cShadow = settings->value("Colors/shadow",QColor(Qt::darkGray)).value<QColor>();
-    cornerRadius = settings->value("Dimensions/cornerRadius",int(10)).value<int>();
-    borderWidth = settings->value("Dimensions/borderWidth",int(2)).value<int>();
+    cComment = setting("Colors/comment",QColor(Qt::darkGreen)).value<QColor>();
+    cPortName = setting("Colors/portName",QColor(Qt::black)).value<QColor>();
+    cPortType = setting("Colors/portType",QColor(Qt::darkBlue)).value<QColor>();
+    cBackground = setting("Colors/background",QColor("#fffff3")).value<QColor>();
+    cHeader1 = setting("Colors/headerLeft",QColor("#014040")).value<QColor>();
+    cHeader2 = setting("Colors/headerRight",QColor("#7f7f7f")).value<QColor>();
+    cTitle = setting("Colors/title",QColor(Qt::white)).value<QColor>();
+    cBorder = setting("Colors/border",QColor("#235676")).value<QColor>();
+    cPorts = setting("Colors/port",QColor("#235676")).value<QColor>();
+    cShadow = setting("Colors/shadow",QColor(Qt::darkGray)).value<QColor>();
+    cornerRadius = setting("Dimensions/cornerRadius",int(10)).value<int>();
+    borderWidth = setting("Dimensions/borderWidth",int(2)).value<int>();
     spacing = 10;
+    lineNumber = 0;
+    entityLine = 0;
+    imageWidth = 0;
+    imageHeight = 0;
+    measuredDpi = -1;
     success = false;
-    createSimplifiedSymbol = simplifiedSymbol;
+    symbolStyle = style;
+    compressOutput = compressed;
+    this->compactPrecision = compactPrecision;
+    writeGeometry = false;
     if(fileName != "")
     {
         success = loadFile(fileName);
@@ -61,37 +87,116 @@ EntityBlock::~EntityBlock()
 
 
 
+}
+
+QVariant EntityBlock::setting(QString key, QVariant defaultValue)
+{
+    if(!settings) //e.g. when only parsing
+        return defaultValue;
+    return settings->value(key, defaultValue);
+}
+
+bool EntityBlock::openInput(QFile &file, QString fileName)
+{
+    if(fileName == "-") //read from stdin
+        return file.open(stdin, QFile::ReadOnly);
+    file.setFileName(fileName);
+    return file.open(QFile::ReadOnly);
+}
+
+///Compares the start of a line case insensitively with keyword, which must be lower case.
+static bool lineStartsWith(const char *line, const char *end, const char *keyword)
+{
+    for(; *keyword; keyword++, line++)
+    {
+        if(line>=end || (*line|0x20)!=*keyword)
+            return false;
+    }
+    return true;
+}
+
+QVector<int> EntityBlock::entityBoundaries(const QByteArray &data)
+{
+    PhaseScope scope(phaseClassify);
+    QVector<int> ends;
+    const char *begin = data.constData();
+    const char *end = begin + data.size();
+    bool entityBusy = false;
+    const char *line = begin;
+    while(line < end)
+    {
+        const char *lineEnd = static_cast<const char*>(memchr(line, '\n', end-line));
+        lineEnd = lineEnd?lineEnd+1:end;
+        const char *p = line;
+        while(p<lineEnd && QChar::isSpace(uchar(*p)))
+            p++;
+        const char *last = lineEnd; //strip trailing whitespace, like QString::simplified
+        while(last>p && QChar::isSpace(uchar(last[-1])))
+            last--;
+        if(!entityBusy)
+        {
+            if(lineStartsWith(p, last, "entity") && p+6<last && QChar::isSpace(uchar(p[6])))
+                entityBusy = true;
+        }
+        else if(lineStartsWith(p, last, "end") && p+3<last &&
+                (QChar::isSpace(uchar(p[3]))||p[3]==';') && memchr(p, ';', last-p))
+        {
+            entityBusy = false;
+            ends.push_back(lineEnd-begin);
+        }
+        line = lineEnd;
+    }
+    return ends;
 }
 
 bool EntityBlock::loadFile(QString fileName)
 {
-    QFile file(fileName);
-    bool success = file.open(QFile::ReadOnly);
-    if(!success){
-        success = false;
+    QFile file;
+    if(!openInput(file, fileName))
         return false;
-    }
+    loadDevice(file);
+    return true;
+}
+
+bool EntityBlock::loadDevice(QIODevice &device)
+{
+    PhaseScope scope(phaseParse); //reading and parsing go line by line, it is all counted as parsing
+    //Forget the previous entity, only the line count continues so line numbers stay those of the device
+    entityName.clear();
+    libraries.clear();
+    ports.clear();
+    generics.clear();
+    diagnosticList.clear();
+    entityLine = 0;
+    measuredDpi = -1;
     QString entityString;
     bool entityBusy = false;
     bool entityFound = false;
-    while(!file.atEnd())
+    while(true)
     {
-        QString line = QString(file.readLine());
+        QByteArray rawLine = device.readLine(); //also works for stdin, where atEnd() is not reliable
+        if(rawLine.isEmpty())
+            break; //end of file, an empty line still contains \n
+        lineNumber++;
+        QString line = QString(rawLine);
         line = line.simplified(); //strip whitespace
         if(line.toLower().startsWith("use"))
         {
             libraries.push_back(line);
         }
-        if(searchNoComments(line.toLower(),"entity", 0)!=-1&&!entityFound)
+        if(line.toLower().startsWith("entity ")&&!entityFound) //only at the start of a line, "u1 : entity work.x" is an instantiation
         {
             entityString = line;
             entityBusy = true;
             entityFound = true;
+            entityLine = lineNumber;
         }
         if(entityBusy)
         {
             entityString.append("\n"+line);
-            if(searchNoComments(entityString.toLower()," is",0)!=-1 && entityName.length()==0) //determine the name of the entity
+            //determine the name of the entity. Lines are joined with \n, so " is" can only be found in the new line
+            QString lowerLine = entityName.isEmpty()?line.toLower():QString();
+            if(entityName.isEmpty() && searchNoComments(lowerLine, StructuralIndex(lowerLine), " is", 0)!=-1)
             {
                 entityName = entityString.split("entity ", Qt::KeepEmptyParts, Qt::CaseInsensitive)[1];
                 entityName = entityName.split(" is", Qt::KeepEmptyParts, Qt::CaseInsensitive)[0].simplified();
@@ -103,66 +208,89 @@ bool EntityBlock::loadFile(QString fileName)
             {
                 entityBusy = false;
                 parseEntityString(entityString);
+                return true; //stop here, the next call continues with the next entity
             }
         }
 
 
     }
-    success = true;
-    return true;
+    if(entityBusy)
+        addDiagnostic(entityLine, true, "entity "+entityName+" is not closed with end");
+    return entityFound;
 }
 
-int EntityBlock::searchNoComments(QString string, QString seed, int from)
+int EntityBlock::searchNoComments(const QString &string, const StructuralIndex &index, QString seed, int from)
 {
-    QString s=string.mid(from,-1);
-    QStringList sComments = s.split("\n");
-    QStringList sNoComments = s.split("\n");
-    int index=0;
-    for(int i=0; i< sNoComments.size(); i++)
+    if(from<0)
+        from = 0;
+    int lineStart = from;
+    while(lineStart <= string.length())
     {
-        if(sNoComments[i].contains("--"))
-        {
-            sNoComments[i] = sNoComments[i].mid(0,sNoComments[i].indexOf("--"));
-        }
-        int n = sNoComments[i].indexOf(seed);
-        if(n>=0)
-            return index+n+from;
-        index += sComments[i].length()+1; //+1 for the newline
+        int n = string.indexOf(seed, lineStart);
+        if(n<0)
+            return -1; //not in the rest of the string at all, comment or not
+        if(n > lineStart && string.lastIndexOf("\n", n-1) >= lineStart)
+            lineStart = string.lastIndexOf("\n", n-1)+1; //skip the lines in between, the seed is not in them
+        int codeEnd;
+        int lineEnd = index.lineEnd(lineStart, &codeEnd);
+        if(n+seed.length() <= codeEnd)
+            return n;
+        lineStart = lineEnd+1; //only found in a comment, try the next line
     }
     return -1;
 
 }
 
-int EntityBlock::searchCloseBracket(QString string)
+///Letters, digits and underscores make up a VHDL identifier.
+static bool isIdentifierChar(QChar c)
 {
-    QStringList sComments = string.split("\n");
-    QStringList sNoComments = string.split("\n");
-    int openBrackets = 0;
-    int index=0;
-    for(int i=0; i< sNoComments.size(); i++)
+    return c.isLetterOrNumber() || c=='_';
+}
+
+int EntityBlock::searchClause(const QString &string, const StructuralIndex &index, QString keyword, int from, int *open)
+{
+    for(int n=searchNoComments(string, index, keyword, from); n!=-1; n=searchNoComments(string, index, keyword, n+1))
     {
-        if(sNoComments[i].contains("--"))
+        int after = n+keyword.length();
+        if((n>0 && isIdentifierChar(string[n-1])) || (after<string.length() && isIdentifierChar(string[after])))
+            continue; //part of a longer name
+        int p = after;
+        while(p<string.length())
         {
-            sNoComments[i] = sNoComments[i].mid(0,sNoComments[i].indexOf("--"));
-        }
-        int open = -1;
-        while(true)
-        {
-            open = sNoComments[i].indexOf("(",open+1);
-            if(open>=0)openBrackets++;
-            else break; //no more open brackets ( on this line.
+            if(string[p].isSpace())
+                p++;
+            else if(index.isComment(p))
+                p = index.lineEnd(p); //continue after the comment, on its newline
+            else
+                break;
         }
-        open=-1;
-        while(true)
+        *open = p<string.length() && string[p]=='('?p:-1;
+        return n;
+    }
+    return -1;
+}
+
+int EntityBlock::searchCloseBracket(const QString &string, const StructuralIndex &index, int from)
+{
+    int openBrackets = 0;
+    bool comment = false;
+    for(int p=index.next(from); p!=-1; p=index.next(p+1))
+    {
+        QChar c = string[p];
+        if(c=='\n')
+            comment = false;
+        else if(comment)
+            continue;
+        else if(index.isComment(p))
+            comment = true; //skip until the end of the line
+        else if(c=='(')
+            openBrackets++;
+        else if(c==')')
         {
-            open = sNoComments[i].indexOf(")",open+1);
-            if(open>=0)openBrackets--;
+            openBrackets--;
             if(openBrackets<0)
-                return index + open;
-            if(open<0)break; //no more close brackets ) on this line.
+                return p;
         }
-
-        index += sComments[i].length()+1;//+1 for the newline
     }
     return -1;
 }
@@ -171,20 +299,29 @@ void EntityBlock::parseEntityString(QString entityString)
 {
     ports.clear();
     generics.clear();
+    //Classify the entity once, all searches below use positions in lower and this index
+    QString lower = entityString.toLower();
+    StructuralIndex index(lower);
     int genericEnd=0;
-    if(searchNoComments(entityString.toLower(),"generic",0)!=-1)
+    int open;
+    int genericStart = searchClause(lower, index, "generic", 0, &open);
+    if(genericStart!=-1)
     {
         QStringList comments;
         QString portString;
         QStringList lines;
-        portString = entityString.mid(searchNoComments(entityString.toLower(), "generic",0),-1); //Take the whole string from the keyword generic
-        portString = portString.mid(searchNoComments(portString,"(",0)+1,-1);
-        genericEnd = searchCloseBracket(portString);
-        int addGenericEnd = entityString.length()-portString.length();
-        portString = portString.mid(0,genericEnd);
-        genericEnd += addGenericEnd;
-
-        lines = portString.split("\n", Qt::SkipEmptyParts);
+        QVector<int> lineNumbers, declarationLines;
+        int clauseLine = entityLineAt(entityString, genericStart);
+        if(open==-1)
+            addDiagnostic(clauseLine, true, "missing ( after generic");
+        int start = open==-1?genericStart:open+1;
+        int close = searchCloseBracket(lower, index, start);
+        if(close==-1)
+            addDiagnostic(clauseLine, true, "unbalanced brackets in generic clause");
+        portString = entityString.mid(start, close==-1?-1:close-start); //the declarations between the brackets
+        genericEnd = close==-1?start-1:close;
+
+        splitLines(portString, entityLineAt(entityString, start), lines, lineNumbers);
         int PortsStripped = 0;
         for(int i=0; i<lines.size(); i++) //First strip the comments and store them in comments
         {
@@ -204,6 +341,8 @@ void EntityBlock::parseEntityString(QString entityString)
                 else
                     comments[PortsStripped+cntPorts-1].append(commentLine);
                 PortsStripped += cntPorts;
+                while(declarationLines.size()<PortsStripped) //a declaration is reported on the line of its ;
+                    declarationLines.push_back(lineNumbers[i]);
 
             }
             else
@@ -211,6 +350,8 @@ void EntityBlock::parseEntityString(QString entityString)
                 int cntPorts = lines[i].count(";");
                 if(i==lines.size()-1&&lines[i].simplified()!="")cntPorts++;
                 PortsStripped += cntPorts;
+                while(declarationLines.size()<PortsStripped)
+                    declarationLines.push_back(lineNumbers[i]);
             }
         }
         while(comments.size()<PortsStripped)
@@ -221,7 +362,8 @@ void EntityBlock::parseEntityString(QString entityString)
         for(int i=0; i<portStrings.size(); i++)
         {
             Port port;
-            port.comment=comments[i].simplified();
+            port.line = declarationLines.value(i, clauseLine);
+            port.comment=comments.value(i).simplified();
             if(port.comment.startsWith("!"))
                 port.comment = port.comment.mid(1,-1).simplified(); //Remove doxygen style comment that starts with --!
             port.comment.remove("-"); //remove every occurrence of -, for those who encapsulate comments in -------------
@@ -238,20 +380,28 @@ void EntityBlock::parseEntityString(QString entityString)
             else
                 port.type = portStrings[i].mid(colonSep+1, defSep).simplified();
             port.direction = in; //Generics don't have a direction
+            checkDeclaration(port, portStrings[i], colonSep, true);
 
             generics.push_back(port);
         }
     }
 
-    if(searchNoComments(entityString.toLower(),"port",genericEnd)!=-1)
+    int portStart = searchClause(lower, index, "port", genericEnd, &open);
+    if(portStart!=-1)
     {
         QStringList comments;
         QString portString;
         QStringList lines;
-        portString = entityString.mid(searchNoComments(entityString.toLower(), "port",genericEnd),-1); //Take the whole string from the keyword port
-        portString = portString.mid(searchNoComments(portString,"(",0)+1,-1);
-        portString = portString.mid(0,searchCloseBracket(portString));
-        lines = portString.split("\n", Qt::SkipEmptyParts);
+        QVector<int> lineNumbers, declarationLines;
+        int clauseLine = entityLineAt(entityString, portStart);
+        if(open==-1)
+            addDiagnostic(clauseLine, true, "missing ( after port");
+        int start = open==-1?portStart:open+1;
+        int close = searchCloseBracket(lower, index, start);
+        if(close==-1)
+            addDiagnostic(clauseLine, true, "unbalanced brackets in port clause");
+        portString = entityString.mid(start, close==-1?-1:close-start); //the declarations between the brackets
+        splitLines(portString, entityLineAt(entityString, start), lines, lineNumbers);
         int PortsStripped = 0;
         for(int i=0; i<lines.size(); i++) //First strip the comments and store them in comments
         {
@@ -271,6 +421,8 @@ void EntityBlock::parseEntityString(QString entityString)
                 else
                     comments[PortsStripped+cntPorts-1].append(commentLine);
                 PortsStripped += cntPorts;
+                while(declarationLines.size()<PortsStripped) //a declaration is reported on the line of its ;
+                    declarationLines.push_back(lineNumbers[i]);
 
             }
             else
@@ -278,6 +430,8 @@ void EntityBlock::parseEntityString(QString entityString)
                 int cntPorts = lines[i].count(";");
                 if(i==lines.size()-1&&lines[i].simplified()!="")cntPorts++;
                 PortsStripped += cntPorts;
+                while(declarationLines.size()<PortsStripped)
+                    declarationLines.push_back(lineNumbers[i]);
             }
         }
         while(comments.size()<PortsStripped)
@@ -288,7 +442,8 @@ void EntityBlock::parseEntityString(QString entityString)
         for(int i=0; i<portStrings.size(); i++)
         {
             Port port;
-            port.comment=comments[i].simplified();
+            port.line = declarationLines.value(i, clauseLine);
+            port.comment=comments.value(i).simplified();
             if(port.comment.startsWith("!"))
                 port.comment = port.comment.mid(1,-1).simplified(); //Remove doxygen style comment that starts with --!
             port.comment.remove("-"); //remove every occurrence of -, for those who encapsulate comments in -------------
@@ -341,6 +496,7 @@ void EntityBlock::parseEntityString(QString entityString)
             }
             else //no type specified, default to in
                 port.direction = in; //Generics don't have a direction
+            checkDeclaration(port, portStrings[i], colonSep, false);
 
             ports.push_back(port);
         }
@@ -348,6 +504,50 @@ void EntityBlock::parseEntityString(QString entityString)
 
 }
 
+int EntityBlock::entityLineAt(const QString &entityString, int position)
+{
+    int newlines = entityString.left(position).count('\n');
+    return entityLine + (newlines>0?newlines-1:0); //the first line of entityString is stored twice
+}
+
+void EntityBlock::splitLines(const QString &string, int firstLine, QStringList &lines, QVector<int> &lineNumbers)
+{
+    QStringList all = string.split("\n");
+    for(int i=0; i<all.size(); i++)
+    {
+        if(all[i].isEmpty())
+            continue;
+        lines.push_back(all[i]);
+        lineNumbers.push_back(firstLine+i);
+    }
+}
+
+void EntityBlock::addDiagnostic(int line, bool error, QString message)
+{
+    Diagnostic d;
+    d.line = line;
+    d.error = error;
+    d.message = message;
+    diagnosticList.push_back(d);
+}
+
+void EntityBlock::checkDeclaration(const Port &port, const QString &declaration, int colonSep, bool generic)
+{
+    if(declaration.simplified()=="")
+    {
+        addDiagnostic(port.line, true, "empty declaration, is there a ; after the last one?");
+        return;
+    }
+    if(colonSep==-1)
+        addDiagnostic(port.line, true, "missing : in declaration \""+declaration.simplified()+"\"");
+    else if(port.name=="")
+        addDiagnostic(port.line, true, "missing name in declaration \""+declaration.simplified()+"\"");
+    if(port.comment.startsWith("l ")||port.comment.startsWith("r "))
+        addDiagnostic(port.line, false, "comment of "+port.name+" starts with a lower case placement, use \"L \" or \"R \"");
+    else if(generic&&(port.comment.startsWith("L ")||port.comment.startsWith("R ")))
+        addDiagnostic(port.line, false, "placement \""+port.comment.left(2)+"\" has no effect on generic "+port.name);
+}
+
 void EntityBlock::paintPortSymbol(QPainter& painter, direction_t direction, int x, int y, bool mirror)
 {
     QPen pen=painter.pen();
@@ -402,10 +602,9 @@ void EntityBlock::paintPortSymbol(QPainter& painter, direction_t direction, int
 
 }
 
-void EntityBlock::paint(QPainter &painter)
+void EntityBlock::groupPorts(QVector<Port> &inputPorts, QVector<Port> &outputPorts, QVector<Port> &clockPorts,
+                             QVector<Port> &resetPorts)
 {
-    QVector<Port> inputPorts, outputPorts, clockPorts, resetPorts;
-
     //Divide the ports in 4 groups. input, clock and reset are on the left, but grouped together. Output ports on the right.
     for(int i=0; i<ports.size(); i++)
     {
@@ -449,222 +648,336 @@ void EntityBlock::paint(QPainter &painter)
             outputPorts.push_back(ports[i]);
 
     }
+}
 
-    QFont nameFont = painter.font();
-    nameFont.setPointSize(10);
-    QFont commentFont = painter.font();
-    commentFont.setPointSize(8);
-    QFont titleFont = painter.font();
-    titleFont.setPointSize(12);
+QString EntityBlock::typeText(const Port &port)
+{
+    QString typeString = port.type;
+    if(port.def!="")typeString += " ("+port.def+")";
+    return typeString;
+}
 
-    QPen namePen = painter.pen();
-    namePen.setColor(cPortName);
-    QPen commentPen = painter.pen();
-    commentPen.setColor(cComment);
-    QPen typePen = painter.pen();
-    typePen.setColor(cPortType);
-    QPen titlePen = painter.pen();
-    titlePen.setColor(cTitle);
-    QPen rectPen = painter.pen();
-    rectPen.setColor(cBorder);
-    rectPen.setWidth(borderWidth);
-    rectPen.setCapStyle(Qt::RoundCap);
-    rectPen.setJoinStyle(Qt::RoundJoin);
-    QBrush rectBrush = painter.brush();
-    rectBrush.setStyle(Qt::SolidPattern);
-    rectBrush.setColor(cBackground);
+QString EntityBlock::genericText(const Port &generic)
+{
+    QString gText = generic.name + " : " + generic.type;
+    if(generic.def!="")
+        gText += " := " + generic.def;
+    return gText;
+}
 
-    int portH=0;
-    int nameH=0;
-    int leftOuter=0;
-    int leftInner=0;
-    int rightInner=0;
-    int rightOuter=0;
-    int genericWidth=0;
+///Port groups with at least this many rows are measured on several threads
+static const int parallelMeasureRows = 1000;
+///Rows per slice, the threads that measure a group take slices until none is left
+static const int measureSliceRows = 250;
 
-    //Determine maximum width and height of generic labels
-    for(int i=0; i<generics.size(); i++)
+///Rows of one port group, divided in slices that the measuring threads take one by one.
+struct MeasureWork
+{
+    typedef void (*MeasureFunction)(const QVector<Port> &group, int begin, int end, const QFont &nameFont,
+                                    const QFont &commentFont, EntityBlock::Columns &columns, bool right);
+
+    MeasureFunction measure;
+    const QVector<Port> *group;
+    QFont nameFont;
+    QFont commentFont;
+    bool right;
+    QAtomicInt nextSlice;
+
+    ///Measures slices into columns until all of them are taken
+    void measureSlices(EntityBlock::Columns &columns)
     {
-        painter.setPen(namePen);
-        painter.setFont(nameFont);
-        QString gText = generics[i].name + " : " + generics[i].type;
-        if(generics[i].def!="")
-            gText += " := " + generics[i].def;
-
-        QRect nameRect = painter.boundingRect(0, 0, 2000, 20, Qt::AlignLeft, gText);
-        painter.setPen(commentPen);
-        painter.setFont(commentFont);
-        QRect commentRect = painter.boundingRect(0, 0, 2000, 20, Qt::AlignLeft, generics[i].comment);
-        if(createSimplifiedSymbol)
-        {
-            portH = nameRect.height();
-            genericWidth = 0;
-        }
-        else
+        while(true)
         {
-            if(nameRect.height()+commentRect.height() > portH)
-                portH = nameRect.height()+commentRect.height();
-            if(nameRect.width()>genericWidth)
-                genericWidth = nameRect.width();
-            if(commentRect.width()>genericWidth)
-                genericWidth = commentRect.width();
+            int begin = nextSlice.fetchAndAddOrdered(1)*measureSliceRows;
+            if(begin >= group->size())
+                return;
+            measure(*group, begin, qMin(begin+measureSliceRows, group->size()), nameFont, commentFont, columns, right);
         }
     }
-    //Determine maximum width and height of input port labels
-    for(int i=0; i<inputPorts.size(); i++)
-    {
-        painter.setPen(namePen);
-        painter.setFont(nameFont);
-        QRect nameRect = painter.boundingRect(0, 0, 2000, 20, Qt::AlignRight, inputPorts[i].name);
-        painter.setPen(commentPen);
-        painter.setFont(commentFont);
-        QRect commentRect = painter.boundingRect(0, 0, 2000, 20, Qt::AlignRight, inputPorts[i].comment);
-        QString typeString = inputPorts[i].type;
-        if(inputPorts[i].def!="")typeString += " ("+inputPorts[i].def+")";
-        painter.setPen(typePen);
-        painter.setFont(nameFont);
-        QRect typeRect = painter.boundingRect(0, 0, 2000, 20, Qt::AlignLeft, typeString);
-        if(createSimplifiedSymbol)
-        {
-            if(nameRect.height() > portH)
-                portH = nameRect.height();
-            leftOuter = 0;
-            if(nameRect.width()>leftInner)
-                leftInner = nameRect.width();
-        }
-        else
-        {
-            if(nameRect.height()+commentRect.height() > portH)
-                portH = nameRect.height()+commentRect.height();
-            if(nameRect.height() > nameH)
-                nameH = nameRect.height();
-            if(nameRect.width()>leftOuter)
-                leftOuter = nameRect.width();
-            if(commentRect.width()>leftInner)
-                leftInner = commentRect.width();
-            if(typeRect.width()>leftInner)
-                leftInner = typeRect.width();
-        }
+};
+
+///Helps measuring a port group on an idle thread of the global pool.
+class MeasureTask : public QRunnable
+{
+public:
+    MeasureTask(MeasureWork *work, QSemaphore *done)
+    {
+        this->work = work;
+        this->done = done;
+        columns.portH = columns.nameH = 0;
+        columns.leftOuter = columns.leftInner = columns.rightInner = columns.rightOuter = columns.genericWidth = 0;
+        setAutoDelete(false); //columns is read after done is released
     }
 
-    //Determine maximum width and height of reset port labels
-    for(int i=0; i<resetPorts.size(); i++)
-    {
-        painter.setPen(namePen);
-        painter.setFont(nameFont);
-        QRect nameRect = painter.boundingRect(0, 0, 2000, 20, Qt::AlignRight, resetPorts[i].name);
-        painter.setPen(commentPen);
-        painter.setFont(commentFont);
-        QRect commentRect = painter.boundingRect(0, 0, 2000, 20, Qt::AlignRight, resetPorts[i].comment);
-        QString typeString = resetPorts[i].type;
-        if(resetPorts[i].def!="")typeString += " ("+resetPorts[i].def+")";
-        painter.setPen(typePen);
-        painter.setFont(nameFont);
-        QRect typeRect = painter.boundingRect(0, 0, 2000, 20, Qt::AlignLeft, typeString);
-        if(createSimplifiedSymbol)
+    void run() override
+    {
+        PhaseScope scope(phaseMeasure);
+        work->measureSlices(columns);
+        done->release();
+    }
+
+    EntityBlock::Columns columns; ///widths and heights of the slices this task measured
+
+private:
+    MeasureWork *work;
+    QSemaphore *done;
+};
+
+void EntityBlock::mergeColumns(Columns &columns, const Columns &slice)
+{
+    columns.portH = qMax(columns.portH, slice.portH);
+    columns.nameH = qMax(columns.nameH, slice.nameH);
+    columns.leftOuter = qMax(columns.leftOuter, slice.leftOuter);
+    columns.leftInner = qMax(columns.leftInner, slice.leftInner);
+    columns.rightInner = qMax(columns.rightInner, slice.rightInner);
+    columns.rightOuter = qMax(columns.rightOuter, slice.rightOuter);
+    columns.genericWidth = qMax(columns.genericWidth, slice.genericWidth);
+}
+
+///Size of a label as QPainter::boundingRect gives it: QFontMetrics also gives an empty string one line of height
+static QRect labelRect(const QFontMetrics &metrics, int flags, const QString &label)
+{
+    if(label.isEmpty())
+        return QRect();
+    return metrics.boundingRect(QRect(0, 0, 2000, 20), flags, label);
+}
+
+template<class Style>
+void EntityBlock::measureRows(const QVector<Port> &group, int begin, int end, const QFont &nameFont,
+                              const QFont &commentFont, Columns &columns, bool right)
+{
+    QFontMetrics nameMetrics(nameFont); //created by the thread that uses it
+    QFontMetrics commentMetrics(commentFont);
+    int &outer = right?columns.rightOuter:columns.leftOuter;
+    int &inner = right?columns.rightInner:columns.leftInner;
+    for(int i=begin; i<end; i++)
+    {
+        QRect nameRect = labelRect(nameMetrics, Qt::AlignRight, group[i].name);
+        int rowH = nameRect.height();
+        if(nameRect.height() > columns.nameH)
+            columns.nameH = nameRect.height();
+        if(Style::namesOutside)
         {
-            if(nameRect.height() > portH)
-                portH = nameRect.height();
-            leftOuter = 0;
-            if(nameRect.width()>leftInner)
-                leftInner = nameRect.width();
+            if(nameRect.width()>outer)
+                outer = nameRect.width();
         }
-        else
+        else if(nameRect.width()>inner)
+            inner = nameRect.width();
+        if(Style::types)
+        {
+            QRect typeRect = labelRect(nameMetrics, Qt::AlignLeft, typeText(group[i]));
+            if(typeRect.width()>inner)
+                inner = typeRect.width();
+        }
+        if(Style::comments)
         {
-            if(nameRect.height()+commentRect.height() > portH)
-                portH = nameRect.height()+commentRect.height();
-            if(nameRect.height() > nameH)
-                nameH = nameRect.height();
-            if(nameRect.width()>leftOuter)
-                leftOuter = nameRect.width();
-            if(commentRect.width()>leftInner)
-                leftInner = commentRect.width();
-            if(typeRect.width()>leftInner)
-                leftInner = typeRect.width();
+            QRect commentRect = labelRect(commentMetrics, Qt::AlignRight, group[i].comment);
+            rowH += commentRect.height();
+            if(commentRect.width()>inner)
+                inner = commentRect.width();
         }
+        if(rowH > columns.portH)
+            columns.portH = rowH;
+    }
+}
 
+template<class Style>
+void EntityBlock::measurePorts(QPainter &painter, const QVector<Port> &group, const TextStyle &text, Columns &columns,
+                               bool right)
+{
+    //Fonts for the resolution of the device, so the metrics match what painter.boundingRect would give
+    QFont nameFont(text.nameFont, painter.device());
+    QFont commentFont(text.commentFont, painter.device());
+    QThreadPool *pool = QThreadPool::globalInstance();
+    if(group.size()<parallelMeasureRows || pool->maxThreadCount()<2)
+    {
+        measureRows<Style>(group, 0, group.size(), nameFont, commentFont, columns, right);
+        return;
     }
 
-    //Determine maximum width and height of clock port labels
-    for(int i=0; i<clockPorts.size(); i++)
+    //A very wide entity: the rows are divided in slices, this thread and the idle threads of the pool take slices
+    //until none is left. Helpers are only started on threads that are free right now, so this thread never waits for
+    //a helper that is not running yet, also when it is a pool thread itself. Every helper has its own maxima, they
+    //are merged at the end.
+    MeasureWork work;
+    work.measure = &EntityBlock::measureRows<Style>;
+    work.group = &group;
+    work.nameFont = nameFont;
+    work.commentFont = commentFont;
+    work.right = right;
+    int slices = (group.size()+measureSliceRows-1)/measureSliceRows;
+    int idle = pool->maxThreadCount()-pool->activeThreadCount();
+    QSemaphore done;
+    QVector<MeasureTask*> tasks;
+    for(int i=0; i<qMin(idle, slices-1); i++)
     {
-        painter.setPen(namePen);
-        painter.setFont(nameFont);
-        QRect nameRect = painter.boundingRect(0, 0, 2000, 20, Qt::AlignRight, clockPorts[i].name);
-        painter.setPen(commentPen);
-        painter.setFont(commentFont);
-        QRect commentRect = painter.boundingRect(0, 0, 2000, 20, Qt::AlignRight, clockPorts[i].comment);
-        QString typeString = clockPorts[i].type;
-        if(clockPorts[i].def!="")typeString += " ("+clockPorts[i].def+")";
-        painter.setPen(typePen);
-        painter.setFont(nameFont);
-        QRect typeRect = painter.boundingRect(0, 0, 2000, 20, Qt::AlignLeft, typeString);
-        if(createSimplifiedSymbol)
+        MeasureTask *task = new MeasureTask(&work, &done);
+        if(!pool->tryStart(task))
         {
-            if(nameRect.height() > portH)
-                portH = nameRect.height();
-            leftOuter = 0;
-            if(nameRect.width()>leftInner)
-                leftInner = nameRect.width();
+            delete task;
+            break;
         }
-        else
+        tasks.append(task);
+    }
+    work.measureSlices(columns);
+    done.acquire(tasks.size()); //the helpers are running, at most finishing their last slice
+    for(int i=0; i<tasks.size(); i++)
+    {
+        mergeColumns(columns, tasks[i]->columns);
+        delete tasks[i];
+    }
+}
+
+template<class Style>
+void EntityBlock::measureGenerics(QPainter &painter, const TextStyle &text, Columns &columns)
+{
+    if(!Style::generics)
+        return;
+    QFontMetrics nameMetrics(QFont(text.nameFont, painter.device()));
+    QFontMetrics commentMetrics(QFont(text.commentFont, painter.device()));
+    for(int i=0; i<generics.size(); i++)
+    {
+        QRect nameRect = labelRect(nameMetrics, Qt::AlignLeft, genericText(generics[i]));
+        int rowH = nameRect.height();
+        if(nameRect.width()>columns.genericWidth)
+            columns.genericWidth = nameRect.width();
+        if(Style::comments)
         {
-            if(nameRect.height()+commentRect.height() > portH)
-                portH = nameRect.height()+commentRect.height();
-            if(nameRect.height() > nameH)
-                nameH = nameRect.height();
-            if(nameRect.width()>leftOuter)
-                leftOuter = nameRect.width();
-            if(commentRect.width()>leftInner)
-                leftInner = commentRect.width();
-            if(typeRect.width()>leftInner)
-                leftInner = typeRect.width();
+            QRect commentRect = labelRect(commentMetrics, Qt::AlignLeft, generics[i].comment);
+            rowH += commentRect.height();
+            if(commentRect.width()>columns.genericWidth)
+                columns.genericWidth = commentRect.width();
         }
-
+        if(rowH > columns.portH)
+            columns.portH = rowH;
     }
+}
 
-    //Determine maximum width and height of output port labels
-    for(int i=0; i<outputPorts.size(); i++)
+template<class Style>
+void EntityBlock::paintPorts(QPainter &painter, const QVector<Port> &group, const TextStyle &text, const Columns &columns,
+                             bool right, const char *groupName, int &y)
+{
+    //Names outside the box are aligned to the box, texts inside the box to the port symbols
+    int outerX = right?imageWidth-columns.rightOuter:0;
+    int outerW = right?columns.rightOuter:columns.leftOuter;
+    int innerX = right?imageWidth-columns.rightOuter-columns.rightInner-(2*spacing):columns.leftOuter+(2*spacing);
+    int innerW = right?columns.rightInner:columns.leftInner;
+    int symbolX = right?imageWidth-columns.rightOuter-(1*spacing):columns.leftOuter+(1*spacing);
+    Qt::Alignment outerAlign = right?Qt::AlignLeft:Qt::AlignRight;
+    Qt::Alignment innerAlign = right?Qt::AlignRight:Qt::AlignLeft;
+    for(int i=0; i<group.size(); i++)
     {
-        painter.setPen(namePen);
-        painter.setFont(nameFont);
-        QRect nameRect = painter.boundingRect(0, 0, 2000, 20, Qt::AlignRight, outputPorts[i].name);
-        painter.setPen(commentPen);
-        painter.setFont(commentFont);
-        QRect commentRect = painter.boundingRect(0, 0, 2000, 20, Qt::AlignRight, outputPorts[i].comment);
-        QString typeString = outputPorts[i].type;
-        if(outputPorts[i].def!="")typeString += " ("+outputPorts[i].def+")";
-        painter.setPen(typePen);
-        painter.setFont(nameFont);
-        QRect typeRect = painter.boundingRect(0, 0, 2000, 20, Qt::AlignLeft, typeString);
-        if(createSimplifiedSymbol)
+        painter.setPen(text.namePen);
+        painter.setFont(text.nameFont);
+        if(Style::namesOutside)
+            painter.drawText(outerX, y+(columns.portH-columns.nameH)/2, outerW, columns.portH, outerAlign, group[i].name);
+        else
+            painter.drawText(innerX, y, innerW, columns.portH, innerAlign, group[i].name);
+        if(Style::comments)
         {
-            if(nameRect.height() > portH)
-                portH = nameRect.height();
-            rightOuter = 0;
-            if(nameRect.width()>rightInner)
-                rightInner = nameRect.width();
+            painter.setPen(text.commentPen);
+            painter.setFont(text.commentFont);
+            painter.drawText(innerX, y+columns.nameH, innerW, columns.portH, innerAlign, group[i].comment);
         }
-        else
+        if(Style::types)
         {
-            if(nameRect.height()+commentRect.height() > portH)
-                portH = nameRect.height()+commentRect.height();
-            if(nameRect.height() > nameH)
-                nameH = nameRect.height();
-            if(nameRect.width()>rightOuter)
-                rightOuter = nameRect.width();
-            if(commentRect.width()>rightInner)
-                rightInner= commentRect.width();
-            if(typeRect.width()>rightInner)
-                rightInner = typeRect.width();
+            painter.setPen(text.typePen);
+            painter.setFont(text.nameFont);
+            painter.drawText(innerX, y, innerW, columns.portH, innerAlign, typeText(group[i]));
         }
+        paintPortSymbol(painter, group[i].direction, symbolX, y+columns.portH/2, right);
+        PortAnchor anchor;
+        anchor.name = group[i].name;
+        anchor.direction = group[i].direction;
+        anchor.group = groupName;
+        anchor.right = right;
+        anchor.anchor = QPoint(symbolX+(right?5:-5), y+columns.portH/2); //port symbols are 10 wide
+        portAnchors.append(anchor);
+        y += columns.portH;
+    }
+}
 
+void EntityBlock::paint(QPainter &painter)
+{
+    switch(symbolStyle)
+    {
+    case minimalStyle:
+        paintStyled<MinimalStyle>(painter);
+        break;
+    case compactStyle:
+        paintStyled<CompactStyle>(painter);
+        break;
+    default:
+        paintStyled<FullStyle>(painter);
+        break;
     }
+}
+
+template<class Style>
+void EntityBlock::paintStyled(QPainter &painter)
+{
+    QVector<Port> inputPorts, outputPorts, clockPorts, resetPorts;
+    groupPorts(inputPorts, outputPorts, clockPorts, resetPorts);
+    portAnchors.clear();
+
+    TextStyle text;
+    text.nameFont = painter.font();
+    text.nameFont.setPointSize(10);
+    text.commentFont = painter.font();
+    text.commentFont.setPointSize(8);
+    text.titleFont = painter.font();
+    text.titleFont.setPointSize(12);
+
+    text.namePen = painter.pen();
+    text.namePen.setColor(cPortName);
+    text.commentPen = painter.pen();
+    text.commentPen.setColor(cComment);
+    text.typePen = painter.pen();
+    text.typePen.setColor(cPortType);
+    text.titlePen = painter.pen();
+    text.titlePen.setColor(cTitle);
+    QPen rectPen = painter.pen();
+    rectPen.setColor(cBorder);
+    rectPen.setWidth(borderWidth);
+    rectPen.setCapStyle(Qt::RoundCap);
+    rectPen.setJoinStyle(Qt::RoundJoin);
+    QBrush rectBrush = painter.brush();
+    rectBrush.setStyle(Qt::SolidPattern);
+    rectBrush.setColor(cBackground);
+
+    //Determine maximum width and height of the generic and port labels
+    Columns columns;
+    columns.portH = columns.nameH = 0;
+    columns.leftOuter = columns.leftInner = columns.rightInner = columns.rightOuter = columns.genericWidth = 0;
+    QRect titleRect;
+    int dpi = painter.device()->logicalDpiY();
+    if(measuredDpi==dpi && measuredFont==text.nameFont)
+    {
+        columns = measuredColumns;
+        titleRect = measuredTitle;
+    }
+    else
+    {
+        PhaseScope scope(phaseMeasure);
+        measureGenerics<Style>(painter, text, columns);
+        measurePorts<Style>(painter, inputPorts, text, columns, false);
+        measurePorts<Style>(painter, resetPorts, text, columns, false);
+        measurePorts<Style>(painter, clockPorts, text, columns, false);
+        measurePorts<Style>(painter, outputPorts, text, columns, true);
+
+        painter.setPen(text.titlePen);
+        painter.setFont(text.titleFont);
+        //determine size of the title block.
+        titleRect = painter.boundingRect(0,0,2000,20, Qt::AlignHCenter, entityName);
+
+        measuredColumns = columns;
+        measuredTitle = titleRect;
+        measuredFont = text.nameFont;
+        measuredDpi = dpi;
+    }
+    int portH = columns.portH;
+    int leftOuter = columns.leftOuter;
 
-    painter.setPen(titlePen);
-    painter.setFont(titleFont);
-    //determine size of the title block.
-    QRect titleRect = painter.boundingRect(0,0,2000,20, Qt::AlignHCenter, entityName);
     //Check whether we have more ports on the left or right side and adjust the height of the rectangle / image
     int leftCount = inputPorts.size() +
             resetPorts.size()+(((resetPorts.size()>0)&&(inputPorts.size()>0))?1:0) +
@@ -672,12 +985,13 @@ void EntityBlock::paint(QPainter &painter)
     if(titleRect.height()<cornerRadius)titleRect.setHeight(cornerRadius);
 
     imageHeight = (leftCount > outputPorts.size()? leftCount:outputPorts.size())*portH + (2*titleRect.height());
-    int rectWidth = (titleRect.width()+(4*spacing)) > (leftInner+rightInner+(6*spacing))?titleRect.width()+(4*spacing): (leftInner+rightInner+(6*spacing));
-    if(genericWidth+(4*spacing)>rectWidth)rectWidth = genericWidth+(4*spacing);
-    if(!createSimplifiedSymbol)
+    int rectWidth = (titleRect.width()+(4*spacing)) > (columns.leftInner+columns.rightInner+(6*spacing))?titleRect.width()+(4*spacing): (columns.leftInner+columns.rightInner+(6*spacing));
+    if(columns.genericWidth+(4*spacing)>rectWidth)rectWidth = columns.genericWidth+(4*spacing);
+    if(Style::generics)
             imageHeight += generics.size()*portH;
 
-    imageWidth = leftOuter+(2*spacing) + rectWidth + rightOuter;
+    imageWidth = leftOuter+(2*spacing) + rectWidth + columns.rightOuter;
+    boxRect = QRect(leftOuter+(1*spacing), 0, rectWidth, imageHeight);
 
 
     //draw the half rounded rectangle around the title
@@ -707,7 +1021,7 @@ void EntityBlock::paint(QPainter &painter)
     painter.drawPath(p1);
 
     //Draw a line between ports and generics.
-    if(generics.size()>0 && !createSimplifiedSymbol)
+    if(Style::generics && generics.size()>0)
     {
         painter.drawLine(leftOuter+spacing, imageHeight-titleRect.height()-generics.size()*portH, leftOuter+spacing+rectWidth,imageHeight-titleRect.height()-generics.size()*portH);
     }
@@ -716,36 +1030,12 @@ void EntityBlock::paint(QPainter &painter)
     int y=titleRect.height();
 
     //Draw title label (centered)
-    painter.setPen(titlePen);
-    painter.setFont(titleFont);
+    painter.setPen(text.titlePen);
+    painter.setFont(text.titleFont);
     painter.drawText(leftOuter+spacing,0,rectWidth,titleRect.height(), Qt::AlignHCenter, entityName);
 
     //Draw input port names, type, comment and symbol
-    for(int i=0; i<inputPorts.size(); i++)
-    {
-        if(!createSimplifiedSymbol)
-        {
-            painter.setPen(namePen);
-            painter.setFont(nameFont);
-            painter.drawText(0,y+(portH-nameH)/2,leftOuter,portH,Qt::AlignRight, inputPorts[i].name);
-            painter.setPen(commentPen);
-            painter.setFont(commentFont);
-            painter.drawText(leftOuter+(2*spacing),y+nameH,leftInner,portH,Qt::AlignLeft, inputPorts[i].comment);
-            painter.setPen(typePen);
-            painter.setFont(nameFont);
-            QString typeString = inputPorts[i].type;
-            if(inputPorts[i].def!="")typeString += " ("+inputPorts[i].def+")";
-            painter.drawText(leftOuter+(2*spacing), y, leftInner, portH, Qt::AlignLeft, typeString);
-        }
-        else
-        {
-            painter.setPen(namePen);
-            painter.setFont(nameFont);
-            painter.drawText(leftOuter+(2*spacing), y, leftInner, portH, Qt::AlignLeft, inputPorts[i].name);
-        }
-        paintPortSymbol(painter,inputPorts[i].direction, leftOuter+(1*spacing), y+portH/2,false);
-        y += portH;
-    }
+    paintPorts<Style>(painter, inputPorts, text, columns, false, "input", y);
 
     //Put one port spacing between input ports and reset ports
     if(inputPorts.size()>0&&
@@ -753,130 +1043,152 @@ void EntityBlock::paint(QPainter &painter)
         y += portH;
 
     //Draw reset port names, type, comment and symbol
-    for(int i=0; i<resetPorts.size(); i++)
-    {
-        if(!createSimplifiedSymbol)
-        {
-            painter.setPen(namePen);
-            painter.setFont(nameFont);
-            painter.drawText(0,y+(portH-nameH)/2,leftOuter,portH,Qt::AlignRight, resetPorts[i].name);
-            painter.setPen(commentPen);
-            painter.setFont(commentFont);
-            painter.drawText(leftOuter+(2*spacing),y+nameH,leftInner,portH,Qt::AlignLeft, resetPorts[i].comment);
-            painter.setPen(typePen);
-            painter.setFont(nameFont);
-            QString typeString = resetPorts[i].type;
-            if(resetPorts[i].def!="")typeString += " ("+resetPorts[i].def+")";
-            painter.drawText(leftOuter+(2*spacing), y, leftInner, portH, Qt::AlignLeft, typeString);
-        }
-        else
-        {
-            painter.setPen(namePen);
-            painter.setFont(nameFont);
-            painter.drawText(leftOuter+(2*spacing), y, leftInner, portH, Qt::AlignLeft, resetPorts[i].name);
-        }
-        paintPortSymbol(painter,resetPorts[i].direction, leftOuter+(1*spacing), y+portH/2,false);
-        y += portH;
-    }
+    paintPorts<Style>(painter, resetPorts, text, columns, false, "reset", y);
 
     //Put one port spacing between reset ports and clock ports
     if(resetPorts.size()>0&&clockPorts.size()>0)
         y += portH;
 
     //Draw clock port names, type, comment and symbol
-    for(int i=0; i<clockPorts.size(); i++)
-    {
-        if(!createSimplifiedSymbol)
-        {
-            painter.setPen(namePen);
-            painter.setFont(nameFont);
-            painter.drawText(0,y+(portH-nameH)/2,leftOuter,portH,Qt::AlignRight, clockPorts[i].name);
-            painter.setPen(commentPen);
-            painter.setFont(commentFont);
-            painter.drawText(leftOuter+(2*spacing),y+nameH,leftInner,portH,Qt::AlignLeft, clockPorts[i].comment);
-            painter.setPen(typePen);
-            painter.setFont(nameFont);
-            QString typeString = clockPorts[i].type;
-            if(clockPorts[i].def!="")typeString += " ("+clockPorts[i].def+")";
-            painter.drawText(leftOuter+(2*spacing), y, leftInner, portH, Qt::AlignLeft, typeString);
-
-        }
-        else
-        {
-            painter.setPen(namePen);
-            painter.setFont(nameFont);
-            painter.drawText(leftOuter+(2*spacing), y, leftInner, portH, Qt::AlignLeft, clockPorts[i].name);
-        }
-        paintPortSymbol(painter,clockPorts[i].direction, leftOuter+(1*spacing), y+portH/2,false);
-        y += portH;
-    }
+    paintPorts<Style>(painter, clockPorts, text, columns, false, "clock", y);
 
     //Put cursor back to the top for the ports on the right side
     int genericY = y;
     y = titleRect.height();
 
     //Draw output port names, type, comment and symbol
-    for(int i=0; i<outputPorts.size(); i++)
-    {
-        if(!createSimplifiedSymbol)
-        {
-            painter.setPen(namePen);
-            painter.setFont(nameFont);
-            painter.drawText(imageWidth-rightOuter,y+(portH-nameH)/2,rightOuter,portH,Qt::AlignLeft, outputPorts[i].name);
-            painter.setPen(commentPen);
-            painter.setFont(commentFont);
-            painter.drawText(imageWidth - rightOuter - rightInner -(2*spacing),y+nameH,rightInner,portH,Qt::AlignRight, outputPorts[i].comment);
-            painter.setPen(typePen);
-            painter.setFont(nameFont);
-            QString typeString = outputPorts[i].type;
-            if(outputPorts[i].def!="")typeString += " ("+outputPorts[i].def+")";
-            painter.drawText(imageWidth - rightOuter - rightInner -(2*spacing), y, rightInner, portH, Qt::AlignRight, typeString);
-
-        }
-        else
-        {
-            painter.setPen(namePen);
-            painter.setFont(nameFont);
-            painter.drawText(imageWidth - rightOuter - rightInner -(2*spacing), y, rightInner, portH, Qt::AlignRight, outputPorts[i].name);
-        }
-        paintPortSymbol(painter,outputPorts[i].direction, imageWidth-rightOuter-(1*spacing), y+portH/2,true);
-        y += portH;
-    }
+    paintPorts<Style>(painter, outputPorts, text, columns, true, "output", y);
 
-    if(!createSimplifiedSymbol)
+    if(Style::generics)
     {
         //Draw generics.
         if(y<genericY)y=genericY;
         for(int i=0; i<generics.size(); i++)
         {
-            painter.setPen(typePen);
-            painter.setFont(nameFont);
-            QString gText = generics[i].name + " : " + generics[i].type;
-            if(generics[i].def!="")
-                gText += " := " + generics[i].def;
-            painter.drawText(leftOuter + (2*spacing),y,rectWidth,portH,Qt::AlignLeft, gText);
-            painter.setPen(commentPen);
-            painter.setFont(commentFont);
-            painter.drawText(leftOuter + (2*spacing),y+nameH,rightOuter,portH,Qt::AlignLeft, generics[i].comment);
+            painter.setPen(text.typePen);
+            painter.setFont(text.nameFont);
+            painter.drawText(leftOuter + (2*spacing),y,rectWidth,portH,Qt::AlignLeft, genericText(generics[i]));
+            if(Style::comments)
+            {
+                painter.setPen(text.commentPen);
+                painter.setFont(text.commentFont);
+                painter.drawText(leftOuter + (2*spacing),y+columns.nameH,columns.rightOuter,portH,Qt::AlignLeft, generics[i].comment);
+            }
             y+= portH;
         }
     }
 }
 
-void EntityBlock::saveSvg(QString targetName)
+QString EntityBlock::name() const
+{
+    return entityName;
+}
+
+QStringList EntityBlock::libraryList() const
+{
+    return libraries;
+}
+
+QList<Port> EntityBlock::portList() const
+{
+    return ports;
+}
+
+QList<Port> EntityBlock::genericList() const
+{
+    return generics;
+}
+
+QList<Diagnostic> EntityBlock::diagnostics() const
+{
+    return diagnosticList;
+}
+
+QString EntityBlock::svgPath(QString targetName)
+{
+    QString path;
+    if(targetName=="-")
+        return targetName;
+    if(targetName.length()==0)
+        path = entityName+".svg";
+    else
+        path = targetName;
+    if(compressOutput)
+    {
+        if(path.endsWith(".svg", Qt::CaseInsensitive))
+            path += "z";
+        else if(!path.endsWith(".svgz", Qt::CaseInsensitive))
+            path += ".svgz";
+    }
+    else if(!path.endsWith(".svg", Qt::CaseInsensitive))
+        path += ".svg";
+    return path;
+}
+
+void EntityBlock::setGeometrySidecar(bool enabled)
 {
+    writeGeometry = enabled;
+}
+
+QByteArray EntityBlock::geometryJson() const
+{
+    QJsonArray viewBox;
+    viewBox << -10 << -10 << imageWidth+20 << imageHeight+20; //same margins as renderSvg
+    QJsonObject box;
+    box.insert("x", boxRect.x());
+    box.insert("y", boxRect.y());
+    box.insert("width", boxRect.width());
+    box.insert("height", boxRect.height());
+    QJsonArray anchors;
+    for(int i=0; i<portAnchors.size(); i++)
+    {
+        QJsonObject port;
+        port.insert("name", portAnchors[i].name);
+        port.insert("direction", QString(direction_names[portAnchors[i].direction]));
+        port.insert("group", portAnchors[i].group);
+        port.insert("side", QString(portAnchors[i].right?"right":"left"));
+        port.insert("x", portAnchors[i].anchor.x());
+        port.insert("y", portAnchors[i].anchor.y());
+        anchors.append(port);
+    }
+    QJsonObject root;
+    root.insert("entity", entityName);
+    root.insert("width", imageWidth+20);
+    root.insert("height", imageHeight+20);
+    root.insert("viewBox", viewBox);
+    root.insert("box", box);
+    root.insert("ports", anchors);
+    return QJsonDocument(root).toJson(QJsonDocument::Compact);
+}
+
+QString EntityBlock::geometryPath(QString svgPath)
+{
+    if(svgPath.endsWith(".svgz", Qt::CaseInsensitive))
+        svgPath.chop(5);
+    else if(svgPath.endsWith(".svg", Qt::CaseInsensitive))
+        svgPath.chop(4);
+    return svgPath+".json";
+}
+
+QSize EntityBlock::paintSymbol(QPainter &painter)
+{
+    PhaseScope scope(phasePaint);
+    paint(painter);
+    return QSize(imageWidth, imageHeight);
+}
+
+QByteArray EntityBlock::renderSvg()
+{
+    PhaseScope scope(phasePaint);
+    QByteArray svg;
     for(int i=0; i<2; i++) //paint the whole thing twice, to calculate the size.
     {
+        svg.clear();
+        QBuffer buffer(&svg);
+        buffer.open(QIODevice::WriteOnly);
         QPainter painter;
-        QString path;
-        if(targetName.length()==0)
-            path = entityName+".svg";
-        else
-            path = targetName;
-        if(!path.endsWith(".svg", Qt::CaseInsensitive))
-            path += ".svg";
         QSvgGenerator generator;
-        generator.setFileName(path);
+        generator.setOutputDevice(&buffer);
         generator.setTitle(entityName);
         generator.setDescription("Block converted from VHDL to svg with entity-block.");
         generator.setSize(QSize(imageWidth+20, imageHeight+20));
@@ -889,4 +1201,40 @@ void EntityBlock::saveSvg(QString targetName)
 
         painter.end();
     }
+    if(compactPrecision>=0)
+    {
+        PhaseScope scope(phaseWrite);
+        svg = SvgMinifier::minify(svg, compactPrecision);
+    }
+    return svg;
+}
+
+bool EntityBlock::saveSvg(QString targetName, SvgWriter *writer, int file, int entity)
+{
+    QString path = svgPath(targetName);
+    QByteArray svg = renderSvg();
+    if(compressOutput)
+    {
+        PhaseScope scope(phaseWrite);
+        svg = GzipWriter::compress(svg);
+        if(svg.isEmpty())
+        {
+            fprintf(stderr, "Could not compress %s\n", path.toLocal8Bit().data());
+            return false;
+        }
+    }
+    bool ok = true;
+    if(writeGeometry && path!="-") //renderSvg recorded the layout
+    {
+        if(writer)
+            writer->enqueue(geometryPath(path), geometryJson(), file, entity);
+        else
+            ok = SvgWriter::publish(geometryPath(path), geometryJson());
+    }
+    if(writer)
+    {
+        writer->enqueue(path, svg, file, entity);
+        return ok;
+    }
+    return SvgWriter::publish(path, svg) && ok;
 }
@@ -24,13 +24,22 @@
 
 #include <QWidget>
 #include <QList>
+#include <QVector>
 #include <QPainter>
 #include <QSettings>
+#include <QFile>
+
+class SvgWriter;
+class StructuralIndex;
 
 ///Types of ports in order to draw the right symbol.
 typedef enum{in, out, inout, buffer, linkage} direction_t;
 const char direction_names[][16]={"in", "out", "inout", "buffer", "linkage"};
 
+///Layouts of a symbol, see symbolstyle.h.
+typedef enum{fullStyle, minimalStyle, compactStyle} symbol_style_t;
+const char style_names[][16]={"full", "minimal", "compact"};
+
 ///Holds the textual properties of an entity port as declared in the VHDL entity. Also used to store generics
 class Port
 {
@@ -41,6 +50,27 @@ public:
     QString type;
     QString comment;
     QString def;
+    int line; ///line in the VHDL file where the declaration ends, 0 if unknown
+};
+
+///Where paint placed a port symbol, for the geometry sidecar.
+class PortAnchor
+{
+public:
+    QString name;
+    direction_t direction;
+    QString group; ///input, reset, clock or output
+    bool right; ///on the right side of the box
+    QPoint anchor; ///outer edge of the port symbol, on the row center: where a wire connects
+};
+
+///A problem found while parsing an entity.
+class Diagnostic
+{
+public:
+    int line;
+    bool error; ///false for a warning
+    QString message;
 };
 
 
@@ -52,18 +82,45 @@ public:
      * @brief EntityBlock Constructor, initializes some values and reads colors from s
      * @param fileName VHDL file to be processed
      * @param targetName SVG file to be stored
-     * @param s
+     * @param s colors and dimensions, NULL for the defaults
+     * @param style full, minimal (names only) or compact (one line per port) symbol
+     * @param compressed store the symbol as gzip compressed .svgz file
+     * @param compactPrecision if 0 or more, write a minified .svg with coordinates rounded to this number of decimals
      */
-    EntityBlock(QString fileName = "", QString targetName="", QSettings* s=NULL, bool simplifiedSymbol=false);
+    EntityBlock(QString fileName = "", QString targetName="", QSettings* s=NULL, symbol_style_t style=fullStyle, bool compressed=false,
+                int compactPrecision=-1);
     ~EntityBlock();
 
     /**
      * @brief loadFile loads a vhdl file from which it extracts the libraries, ports and generics in the entity.
      * This function is already called from the constructor, but can be used separately if fileName = "" in constructor.
-     * @param fileName full path of the VHDL file to load.
+     * @param fileName full path of the VHDL file to load, or - for stdin.
      */
     bool loadFile(QString fileName);
 
+    /**
+     * @brief loadDevice reads from device until the end of the next entity and extracts the libraries, ports and generics.
+     * Calling it again on the same device continues with the next entity, so every entity in a stream can be read.
+     * Every call replaces the name, libraries, ports, generics and diagnostics of the previous entity.
+     * @param device open device to read VHDL from, e.g. a file or stdin.
+     * @return false if no entity was found before the end of the device.
+     */
+    bool loadDevice(QIODevice &device);
+
+    /**
+     * @brief entityBoundaries finds where the entities in a VHDL file end, with a quick scan over the lines
+     * that uses the same entity and end rules as loadDevice. Splitting data at these offsets gives chunks
+     * that each contain exactly one entity (and the lines before it), which can be loaded in parallel.
+     * @param data contents of a VHDL file
+     * @return offset just past the end line of every entity, in file order
+     */
+    static QVector<int> entityBoundaries(const QByteArray &data);
+
+    /**
+     * @brief openInput opens fileName for reading, - opens stdin.
+     */
+    static bool openInput(QFile &file, QString fileName);
+
     /**
      * @brief success false if loadFile did not complete successfully
      */
@@ -72,9 +129,76 @@ public:
     /**
      * @brief saveSvg saves the loaded entity as .svg image.
      * This function is already called from the constructor, but can be used separately if fileName = "" in constructor.
-     * @param targetName
+     * @param targetName file name, or - for stdout
+     * @param writer if set, the image is handed to this writer thread instead of being written directly.
+     * @param file index of the input file, orders the image in an archive of the writer
+     * @param entity index of the entity in that file
+     * @return false if the file could not be written.
+     */
+    bool saveSvg(QString targetName, SvgWriter *writer=NULL, int file=-1, int entity=-1);
+
+    /**
+     * @brief renderSvg paints the loaded entity into an in-memory .svg image, minified if a compact precision was set.
+     * @return contents of the .svg file
+     */
+    QByteArray renderSvg();
+
+    /**
+     * @brief setGeometrySidecar also write a .json file next to every symbol saved by saveSvg, with the image size,
+     * the box and the anchor of every port, see geometryJson
+     */
+    void setGeometrySidecar(bool enabled);
+
+    /**
+     * @brief geometryJson layout of the last painted symbol, in the coordinates of the .svg file:
+     * {"entity", "width", "height", "viewBox": [x, y, width, height], "box": {"x", "y", "width", "height"},
+     * "ports": [{"name", "direction", "group", "side", "x", "y"}]}. Ports are listed in drawing order.
+     */
+    QByteArray geometryJson() const;
+
+    /**
+     * @brief geometryPath file name of the sidecar for the symbol at svgPath: .svg or .svgz replaced by .json
+     */
+    static QString geometryPath(QString svgPath);
+
+    /**
+     * @brief paintSymbol paints the loaded entity with its top left corner at 0,0, e.g. as part of a larger drawing.
+     * The port symbols, the shadow and half the border extend a few pixels beyond the returned size.
+     * The labels are only measured again if the font or the resolution differ from the previous paint.
+     * @return size of the symbol
+     */
+    QSize paintSymbol(QPainter &painter);
+
+    /**
+     * @brief svgPath file name saveSvg uses for targetName: the entity name if targetName is empty, always ending in .svg (or .svgz)
+     */
+    QString svgPath(QString targetName);
+
+    /**
+     * @brief name of the loaded entity
+     */
+    QString name() const;
+
+    /**
+     * @brief libraryList libraries (use clauses) found before the entity
+     */
+    QStringList libraryList() const;
+
+    /**
+     * @brief portList ports of the loaded entity, in declaration order
+     */
+    QList<Port> portList() const;
+
+    /**
+     * @brief genericList generics of the loaded entity, in declaration order
+     */
+    QList<Port> genericList() const;
+
+    /**
+     * @brief diagnostics errors and warnings found while loading: malformed declarations, unbalanced brackets,
+     * unknown placement comments, with the line numbers in the loaded file
      */
-    void saveSvg(QString targetName);
+    QList<Diagnostic> diagnostics() const;
 
 
 private:
@@ -83,6 +207,11 @@ private:
      */
     QSettings *settings;
 
+    /**
+     * @brief setting value of key in settings, or defaultValue if there are no settings
+     */
+    QVariant setting(QString key, QVariant defaultValue);
+
     /**
      * @brief paintPortSymbol draws a symbol for ports (in, out, inout, buffer, linkage)
      * @param painter QPainter to draw on.
@@ -93,12 +222,82 @@ private:
      */
     void paintPortSymbol(QPainter& painter, direction_t direction, int x, int y, bool mirror);
 
+    ///Fonts and pens of the texts in a symbol
+    struct TextStyle
+    {
+        QFont nameFont, commentFont, titleFont;
+        QPen namePen, commentPen, typePen, titlePen;
+    };
+
+    ///Measured row height and column widths of a symbol
+    struct Columns
+    {
+        int portH; ///height of one port or generic row
+        int nameH; ///height of a port name, the comment is drawn below it
+        int leftOuter; ///width of the port names left of the box
+        int leftInner; ///width of the texts inside the box, left side
+        int rightInner;
+        int rightOuter;
+        int genericWidth;
+    };
+
     /**
      * @brief paint draws the symbol including all ports and strings on a QPainter. Could be svg or anything else in Qt.
      * @param painter QPainter object to draw on
      */
     void paint(QPainter &painter);
 
+    /**
+     * @brief paintStyled paint for one layout policy from symbolstyle.h
+     */
+    template<class Style> void paintStyled(QPainter &painter);
+
+    /**
+     * @brief measurePorts widens columns to fit the labels of group. The rows of a very large group are measured
+     * on several threads.
+     * @param right true for the ports on the right side of the entity
+     */
+    template<class Style> void measurePorts(QPainter &painter, const QVector<Port> &group, const TextStyle &text,
+                                            Columns &columns, bool right);
+
+    /**
+     * @brief measureRows widens columns to fit the labels of the rows begin to end of group.
+     * Uses only its arguments, so it can run on any thread.
+     * @param nameFont font for the names and types, resolved for the paint device
+     * @param commentFont font for the comments, resolved for the paint device
+     */
+    template<class Style> static void measureRows(const QVector<Port> &group, int begin, int end, const QFont &nameFont,
+                                                  const QFont &commentFont, Columns &columns, bool right);
+
+    ///mergeColumns widens columns to the maxima of slice
+    static void mergeColumns(Columns &columns, const Columns &slice);
+    friend class MeasureTask;
+    friend struct MeasureWork;
+
+    /**
+     * @brief measureGenerics widens columns to fit the generic labels
+     */
+    template<class Style> void measureGenerics(QPainter &painter, const TextStyle &text, Columns &columns);
+
+    /**
+     * @brief paintPorts draws the labels and symbols of group, one row per port starting at y
+     * @param right true for the ports on the right side of the entity
+     * @param groupName name of the group in the geometry sidecar
+     * @param y top of the first row, moved below the last row
+     */
+    template<class Style> void paintPorts(QPainter &painter, const QVector<Port> &group, const TextStyle &text,
+                                          const Columns &columns, bool right, const char *groupName, int &y);
+
+    /**
+     * @brief groupPorts divides the ports over the left (input, reset, clock) and right (output) side of the symbol
+     */
+    void groupPorts(QVector<Port> &inputPorts, QVector<Port> &outputPorts, QVector<Port> &clockPorts, QVector<Port> &resetPorts);
+
+    ///type of a port with its default value
+    static QString typeText(const Port &port);
+    ///name, type and default value of a generic
+    static QString genericText(const Port &generic);
+
     /**
      * @brief parseEntityString reads a QString containing the entity part of a VHDL file and creates two QLists: ports and generics
      * @param entityString entity part of the VHDL file
@@ -108,19 +307,57 @@ private:
     /**
      * @brief searchNoComments is a helper function to find a string, but it skips vhdl comments marked as --
      * @param string Text to search through
+     * @param index StructuralIndex of string, built once by the caller for all searches in the same string
      * @param seed Text to search for
      * @param from Start searching from this position in the string
      * @return position of text found, -1 if not found.
      */
-    int searchNoComments(QString string, QString seed, int from);
+    int searchNoComments(const QString &string, const StructuralIndex &index, QString seed, int from);
+
+    /**
+     * @brief searchClause finds a keyword like generic or port as a whole word outside comments, so names like
+     * generic_sel or port_a are skipped.
+     * @param string lower case text to search through
+     * @param index StructuralIndex of string
+     * @param keyword lower case keyword
+     * @param from Start searching from this position in the string
+     * @param open receives the position of the ( that follows the keyword, white space and comments in between
+     * are skipped. -1 if the keyword is followed by something else.
+     * @return position of the keyword, -1 if not found.
+     */
+    int searchClause(const QString &string, const StructuralIndex &index, QString keyword, int from, int *open);
 
     /**
      * @brief searchCloseBracket Searches the location of the first unmatched close bracket ).
-     * It assumes that the opening bracket was already removed from the string.
-     * @param string Text to search in, beginning the character after the opening bracket (
-     * @return location of the close bracket or -1 if not found.
+     * Brackets in comments are skipped.
+     * @param string Text to search in
+     * @param index StructuralIndex of string
+     * @param from position of the character after the opening bracket (
+     * @return location of the close bracket in string or -1 if not found.
      */
-    int searchCloseBracket(QString string);
+    int searchCloseBracket(const QString &string, const StructuralIndex &index, int from);
+
+    /**
+     * @brief entityLineAt line in the VHDL file of a position in the entity string built by loadDevice
+     */
+    int entityLineAt(const QString &entityString, int position);
+
+    /**
+     * @brief splitLines splits string in its non-empty lines
+     * @param firstLine line number of the first line of string
+     * @param lines receives the non-empty lines
+     * @param lineNumbers receives the line number of every line in lines
+     */
+    void splitLines(const QString &string, int firstLine, QStringList &lines, QVector<int> &lineNumbers);
+
+    void addDiagnostic(int line, bool error, QString message);
+
+    /**
+     * @brief checkDeclaration adds diagnostics for a malformed port or generic declaration
+     * @param declaration the declaration text without comment
+     * @param colonSep position of the : in declaration
+     */
+    void checkDeclaration(const Port &port, const QString &declaration, int colonSep, bool generic);
 
     /**
      * @brief entityName contains the name of the entity, used as a title for the symbol and filename for
@@ -142,6 +379,20 @@ private:
      */
     QList<Port> generics;
 
+    /**
+     * @brief diagnosticList problems found by loadDevice and parseEntityString
+     */
+    QList<Diagnostic> diagnosticList;
+
+    /**
+     * @brief lineNumber number of lines read by loadDevice so far
+     */
+    int lineNumber;
+    /**
+     * @brief entityLine line on which the entity starts
+     */
+    int entityLine;
+
     /**
      * @brief imageWidth automatically determined in paint function
      */
@@ -150,6 +401,23 @@ private:
      * @brief imageHeight automatically determined in paint function
      */
     int imageHeight;
+    /**
+     * @brief boxRect rounded rectangle of the symbol, determined in paint function
+     */
+    QRect boxRect;
+    /**
+     * @brief portAnchors port symbols drawn by the paint function
+     */
+    QList<PortAnchor> portAnchors;
+    /**
+     * @brief measuredColumns label sizes measured by the last paint, reused by the next paint as long as the entity,
+     * the font and the resolution of the paint device stay the same, e.g. for every instance in a hierarchy diagram.
+     * measuredDpi is -1 when nothing was measured yet.
+     */
+    Columns measuredColumns;
+    QRect measuredTitle;
+    QFont measuredFont;
+    int measuredDpi;
 
     /**
      * Several colors and dimensions, read from QSettings, used to draw the symbol
@@ -158,7 +426,10 @@ private:
     int cornerRadius;
     int borderWidth;
     int spacing;
-    bool createSimplifiedSymbol;
+    symbol_style_t symbolStyle;
+    bool compressOutput;
+    int compactPrecision;
+    bool writeGeometry;
 
 
 };
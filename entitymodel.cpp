@@ -0,0 +1,186 @@
+/**
+ *  This program creates an SVG (Scalable Vector Graphics) symbol out of
+ *  a VHDL entity
+ *
+ *  Copyright (C) 2019  Frans Schreuder info@schreuderelectronics.com
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "entitymodel.h"
+#include "svgwriter.h"
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QHash>
+#include <QMutexLocker>
+#include <QtEndian>
+#include <string.h>
+
+void EntityModelExport::add(int file, int entity, const EntityBlock &block)
+{
+    Entity e;
+    e.name = block.name();
+    e.libraries = block.libraryList();
+    e.generics = block.genericList();
+    e.ports = block.portList();
+    QMutexLocker locker(&mutex);
+    entities.insert(qMakePair(file, entity), e);
+}
+
+static QJsonObject portToJson(const Port &port, bool withDirection)
+{
+    QJsonObject o;
+    o["name"] = port.name;
+    if(withDirection)
+        o["direction"] = QString(direction_names[port.direction]);
+    o["type"] = port.type;
+    o["default"] = port.def;
+    o["comment"] = port.comment;
+    return o;
+}
+
+bool EntityModelExport::writeJson(QString fileName)
+{
+    QByteArray out;
+    foreach(const Entity &e, entities)
+    {
+        QJsonObject o;
+        o["entity"] = e.name;
+        o["libraries"] = QJsonArray::fromStringList(e.libraries);
+        QJsonArray generics, ports;
+        for(int i=0; i<e.generics.size(); i++)
+            generics.append(portToJson(e.generics[i], false));
+        for(int i=0; i<e.ports.size(); i++)
+            ports.append(portToJson(e.ports[i], true));
+        o["generics"] = generics;
+        o["ports"] = ports;
+        out += QJsonDocument(o).toJson(QJsonDocument::Compact);
+        out += "\n";
+    }
+    return SvgWriter::publish(fileName, out);
+}
+
+///Collects NUL terminated UTF-8 strings, every distinct string is stored once.
+class StringTable
+{
+public:
+    StringTable()
+    {
+        data.append('\0'); //offset 0 is the empty string
+    }
+
+    quint32 add(const QString &s)
+    {
+        if(s.isEmpty())
+            return 0;
+        QHash<QString, quint32>::const_iterator it = offsets.constFind(s);
+        if(it != offsets.constEnd())
+            return it.value();
+        quint32 offset = data.size();
+        data.append(s.toUtf8());
+        data.append('\0');
+        offsets.insert(s, offset);
+        return offset;
+    }
+
+    QByteArray data;
+
+private:
+    QHash<QString, quint32> offsets;
+};
+
+static void appendWord(QByteArray &out, quint32 word)
+{
+    quint32 le = qToLittleEndian(word);
+    out.append(reinterpret_cast<const char*>(&le), sizeof(le));
+}
+
+bool EntityModelExport::writeBinary(QString fileName)
+{
+    StringTable strings;
+    QByteArray entityTable, portTable, libraryTable;
+    quint32 portCount = 0, libraryCount = 0;
+
+    foreach(const Entity &e, entities)
+    {
+        EntityModelEntity entity;
+        entity.name = strings.add(e.name);
+        entity.firstLibrary = libraryCount;
+        entity.libraryCount = e.libraries.size();
+        for(int i=0; i<e.libraries.size(); i++)
+        {
+            appendWord(libraryTable, strings.add(e.libraries[i]));
+        }
+        libraryCount += e.libraries.size();
+
+        QList<Port> all = e.generics + e.ports;
+        entity.firstGeneric = portCount;
+        entity.genericCount = e.generics.size();
+        entity.firstPort = portCount + e.generics.size();
+        entity.portCount = e.ports.size();
+        for(int i=0; i<all.size(); i++)
+        {
+            EntityModelPort port;
+            port.name = strings.add(all[i].name);
+            port.direction = all[i].direction;
+            port.type = strings.add(all[i].type);
+            port.def = strings.add(all[i].def);
+            port.comment = strings.add(all[i].comment);
+            appendWord(portTable, port.name);
+            appendWord(portTable, port.direction);
+            appendWord(portTable, port.type);
+            appendWord(portTable, port.def);
+            appendWord(portTable, port.comment);
+        }
+        portCount += all.size();
+        appendWord(entityTable, entity.name);
+        appendWord(entityTable, entity.firstLibrary);
+        appendWord(entityTable, entity.libraryCount);
+        appendWord(entityTable, entity.firstGeneric);
+        appendWord(entityTable, entity.genericCount);
+        appendWord(entityTable, entity.firstPort);
+        appendWord(entityTable, entity.portCount);
+    }
+    while(strings.data.size()%4)
+        strings.data.append('\0');
+
+    EntityModelHeader header;
+    memcpy(header.magic, ENTITYMODEL_MAGIC, 4);
+    header.version = ENTITYMODEL_VERSION;
+    header.entityCount = entities.size();
+    header.entityOffset = sizeof(header);
+    header.portCount = portCount;
+    header.portOffset = header.entityOffset + entityTable.size();
+    header.libraryCount = libraryCount;
+    header.libraryOffset = header.portOffset + portTable.size();
+    header.stringBytes = strings.data.size();
+    header.stringOffset = header.libraryOffset + libraryTable.size();
+
+    QByteArray out(header.magic, 4);
+    appendWord(out, header.version);
+    appendWord(out, header.entityCount);
+    appendWord(out, header.entityOffset);
+    appendWord(out, header.portCount);
+    appendWord(out, header.portOffset);
+    appendWord(out, header.libraryCount);
+    appendWord(out, header.libraryOffset);
+    appendWord(out, header.stringBytes);
+    appendWord(out, header.stringOffset);
+    out += entityTable;
+    out += portTable;
+    out += libraryTable;
+    out += strings.data;
+    return SvgWriter::publish(fileName, out);
+}
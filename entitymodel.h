@@ -0,0 +1,129 @@
+/**
+ *  This program creates an SVG (Scalable Vector Graphics) symbol out of
+ *  a VHDL entity
+ *
+ *  Copyright (C) 2019  Frans Schreuder info@schreuderelectronics.com
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef ENTITYMODEL_H
+#define ENTITYMODEL_H
+
+#include <QString>
+#include <QStringList>
+#include <QList>
+#include <QMap>
+#include <QPair>
+#include <QMutex>
+#include <QtGlobal>
+#include "entityblock.h"
+
+/**
+ * Binary entity model, version 1. All numbers are little endian quint32, every table is 4 byte aligned,
+ * so the file can be mapped into memory and read through these structs without any parsing:
+ *
+ *   EntityModelHeader
+ *   EntityModelEntity[entityCount]  at entityOffset
+ *   EntityModelPort[portCount]      at portOffset, generics and ports of all entities
+ *   quint32[libraryCount]           at libraryOffset, string offsets of the libraries of all entities
+ *   char[stringBytes]               at stringOffset, NUL terminated UTF-8 strings
+ *
+ * A string is stored as offset relative to stringOffset, offset 0 is the empty string.
+ */
+#define ENTITYMODEL_MAGIC "EBLK"
+#define ENTITYMODEL_VERSION 1
+
+struct EntityModelHeader
+{
+    char magic[4];
+    quint32 version;
+    quint32 entityCount;
+    quint32 entityOffset;
+    quint32 portCount;
+    quint32 portOffset;
+    quint32 libraryCount;
+    quint32 libraryOffset;
+    quint32 stringBytes;
+    quint32 stringOffset;
+};
+
+struct EntityModelEntity
+{
+    quint32 name;
+    quint32 firstLibrary;
+    quint32 libraryCount;
+    quint32 firstGeneric; ///index in the port table
+    quint32 genericCount;
+    quint32 firstPort; ///index in the port table
+    quint32 portCount;
+};
+
+struct EntityModelPort
+{
+    quint32 name;
+    quint32 direction; ///direction_t, always in for generics
+    quint32 type;
+    quint32 def;
+    quint32 comment;
+};
+
+Q_STATIC_ASSERT(sizeof(EntityModelHeader) == 40);
+Q_STATIC_ASSERT(sizeof(EntityModelEntity) == 28);
+Q_STATIC_ASSERT(sizeof(EntityModelPort) == 20);
+
+/**
+ * @brief EntityModelExport collects the parsed model of many entities and writes it as JSON lines or
+ * in the binary format above, so other tools can use the entities without parsing VHDL.
+ * add() may be called from several threads.
+ */
+class EntityModelExport
+{
+
+public:
+    /**
+     * @brief add stores a copy of the parsed entity
+     * @param file index of the input file, the output is sorted on file and entity
+     * @param entity index of the entity within the file
+     * @param block entity that was loaded with loadFile or loadDevice
+     */
+    void add(int file, int entity, const EntityBlock &block);
+
+    /**
+     * @brief writeJson writes one JSON object per entity per line
+     * @param fileName output file, - for stdout
+     */
+    bool writeJson(QString fileName);
+
+    /**
+     * @brief writeBinary writes all entities in the binary entity model format
+     * @param fileName output file, - for stdout
+     */
+    bool writeBinary(QString fileName);
+
+private:
+    struct Entity
+    {
+        QString name;
+        QStringList libraries;
+        QList<Port> generics;
+        QList<Port> ports;
+    };
+
+    QMap<QPair<int, int>, Entity> entities;
+    QMutex mutex;
+};
+
+#endif // ENTITYMODEL_H
@@ -0,0 +1,607 @@
+/**
+ *  This program creates an SVG (Scalable Vector Graphics) symbol out of
+ *  a VHDL entity
+ *
+ *  Copyright (C) 2019  Frans Schreuder info@schreuderelectronics.com
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "hierarchy.h"
+#include "svgwriter.h"
+#include "allocstats.h"
+#include <stdio.h>
+#include <QFile>
+#include <QBuffer>
+#include <QSet>
+#include <QRegularExpression>
+#include <QPainterPath>
+#include <QtSvg/QSvgGenerator>
+#include <algorithm>
+
+///Horizontal space between the layers and vertical space between the instances of a layer
+static const int layerGap = 80;
+static const int instanceGap = 30;
+///Size of the box drawn for an instance of an entity that was not found in the input files
+static const int unknownWidth = 120;
+static const int unknownHeight = 40;
+
+/**
+ * @brief closeBracket position of the ) that closes the bracket opened just before from, -1 if there is none
+ */
+static int closeBracket(const QString &code, int from)
+{
+    int depth = 1;
+    for(int i=from; i<code.size(); i++)
+    {
+        if(code[i]=='(')
+            depth++;
+        else if(code[i]==')' && --depth==0)
+            return i;
+    }
+    return -1;
+}
+
+/**
+ * @brief signalName the signal of an actual in a port map, without index or record field, in lower case.
+ * Empty for open, literals and expressions.
+ */
+static QString signalName(const QString &actual)
+{
+    static const QRegularExpression signalExpression("^([a-z]\\w*)\\s*(\\(.*\\)|\\..*)?$");
+    QRegularExpressionMatch match = signalExpression.match(actual.toLower());
+    if(!match.hasMatch() || match.captured(1)=="open")
+        return QString();
+    return match.captured(1);
+}
+
+Hierarchy::Hierarchy(QSettings *s, symbol_style_t style)
+{
+    settings = s;
+    symbolStyle = style;
+    edgeColor = settings?settings->value("Colors/port",QColor("#235676")).value<QColor>():QColor("#235676");
+}
+
+bool Hierarchy::addFile(QString fileName)
+{
+    QFile file;
+    if(!EntityBlock::openInput(file, fileName))
+        return false;
+    QByteArray data;
+    {
+        PhaseScope scope(phaseRead);
+        data = file.readAll();
+    }
+
+    //Index the entities, for their symbols and port directions
+    QVector<int> ends = EntityBlock::entityBoundaries(data);
+    int begin = 0;
+    for(int i=0; i<ends.size(); i++)
+    {
+        QByteArray chunk = QByteArray::fromRawData(data.constData()+begin, ends[i]-begin);
+        QBuffer buffer(&chunk);
+        buffer.open(QIODevice::ReadOnly);
+        EntityBlock block("", "", settings, symbolStyle);
+        if(block.loadDevice(buffer) && !blockIndex.contains(block.name().toLower()))
+        {
+            blockIndex.insert(block.name().toLower(), blocks.size());
+            blocks.append(block);
+        }
+        begin = ends[i];
+    }
+
+    parseArchitectures(QString::fromUtf8(data));
+    return true;
+}
+
+void Hierarchy::parseArchitectures(const QString &text)
+{
+    //Blank out the comments, so they can not match, but keep all positions
+    QString code = text;
+    bool inString = false;
+    for(int i=0; i<code.size(); i++)
+    {
+        if(code[i]=='\n')
+            inString = false;
+        else if(code[i]=='"')
+            inString = !inString;
+        else if(!inString && code[i]=='-' && i+1<code.size() && code[i+1]=='-')
+        {
+            int end = code.indexOf('\n', i);
+            if(end<0)
+                end = code.size();
+            for(; i<end; i++)
+                code[i] = ' ';
+            i--;
+        }
+    }
+
+    static const QRegularExpression architectureExpression("\\barchitecture\\s+\\w+\\s+of\\s+(\\w+)\\s+is\\b",
+                                                           QRegularExpression::CaseInsensitiveOption);
+    //label : entity lib.name(arch), label : component name or label : name, followed by a generic or port map
+    static const QRegularExpression instanceExpression(
+                "\\b(\\w+)\\s*:\\s*(?:entity\\s+(?:\\w+\\.)*(\\w+)(?:\\s*\\(\\s*\\w+\\s*\\))?|component\\s+(\\w+)|(\\w+))"
+                "\\s*\\b(generic|port)\\s+map\\s*\\(",
+                QRegularExpression::CaseInsensitiveOption);
+    static const QRegularExpression portMapExpression("\\s*port\\s+map\\s*\\(", QRegularExpression::CaseInsensitiveOption);
+
+    QVector<QPair<int, QString> > architectures; //position and entity of every architecture
+    QRegularExpressionMatchIterator a = architectureExpression.globalMatch(code);
+    while(a.hasNext())
+    {
+        QRegularExpressionMatch match = a.next();
+        architectures.append(qMakePair(match.capturedStart(), match.captured(1).toLower()));
+    }
+
+    int architecture = -1;
+    QRegularExpressionMatchIterator m = instanceExpression.globalMatch(code);
+    while(m.hasNext())
+    {
+        QRegularExpressionMatch match = m.next();
+        while(architecture+1<architectures.size() && architectures[architecture+1].first<match.capturedStart())
+            architecture++;
+        if(architecture<0)
+            continue; //not in an architecture
+        Instance instance;
+        instance.label = match.captured(1);
+        for(int c=2; c<=4; c++)
+            if(match.capturedLength(c)>0)
+                instance.entity = match.captured(c).toLower();
+        instance.parent = architectures[architecture].second;
+
+        int mapStart = match.capturedEnd();
+        int mapEnd = closeBracket(code, mapStart);
+        if(mapEnd<0)
+            continue;
+        if(match.captured(5).toLower()=="generic") //skip the generic map, the port map follows it
+        {
+            QRegularExpressionMatch portMap = portMapExpression.match(code, mapEnd+1, QRegularExpression::NormalMatch,
+                                                                      QRegularExpression::AnchoredMatchOption);
+            mapEnd = -1;
+            if(portMap.hasMatch())
+            {
+                mapStart = portMap.capturedEnd();
+                mapEnd = closeBracket(code, mapStart);
+            }
+        }
+        if(mapEnd>=0)
+            parsePortMap(code.mid(mapStart, mapEnd-mapStart), instance);
+        instanceList.append(instance);
+    }
+}
+
+void Hierarchy::parsePortMap(const QString &map, Instance &instance)
+{
+    //Split on the commas that are not inside brackets
+    QStringList associations;
+    int depth = 0;
+    int start = 0;
+    for(int i=0; i<map.size(); i++)
+    {
+        if(map[i]=='(')
+            depth++;
+        else if(map[i]==')')
+            depth--;
+        else if(map[i]==',' && depth==0)
+        {
+            associations.append(map.mid(start, i-start));
+            start = i+1;
+        }
+    }
+    associations.append(map.mid(start));
+
+    for(int i=0; i<associations.size(); i++)
+    {
+        QString formal;
+        QString actual = associations[i];
+        int arrow = actual.indexOf("=>");
+        if(arrow>=0)
+        {
+            formal = actual.left(arrow).simplified().toLower();
+            actual = actual.mid(arrow+2);
+            int bracket = formal.indexOf('('); //a slice or element of the port
+            if(bracket>=0)
+                formal = formal.left(bracket).simplified();
+        }
+        instance.portMap.append(qMakePair(formal, actual.simplified()));
+    }
+}
+
+QList<Instance> Hierarchy::instances() const
+{
+    return instanceList;
+}
+
+QString Hierarchy::top() const
+{
+    QHash<QString, int> count;
+    QSet<QString> instantiated;
+    for(int i=0; i<instanceList.size(); i++)
+    {
+        count[instanceList[i].parent]++;
+        instantiated.insert(instanceList[i].entity);
+    }
+    QString best;
+    bool bestInstantiated = true;
+    for(QHash<QString, int>::const_iterator it=count.constBegin(); it!=count.constEnd(); ++it)
+    {
+        bool isInstantiated = instantiated.contains(it.key());
+        if(best.isEmpty() || (bestInstantiated && !isInstantiated) ||
+                (bestInstantiated==isInstantiated && (it.value()>count[best] || (it.value()==count[best] && it.key()<best))))
+        {
+            best = it.key();
+            bestInstantiated = isInstantiated;
+        }
+    }
+    return best;
+}
+
+///Appends the edge from to, unless it is a loop or already there.
+static void addEdge(QVector<QPair<int, int> > &edges, QSet<qint64> &seen, int from, int to)
+{
+    qint64 key = (qint64(from)<<32)|to;
+    if(from==to || seen.contains(key))
+        return;
+    seen.insert(key);
+    edges.append(qMakePair(from, to));
+}
+
+QVector<QPair<int, int> > Hierarchy::connect(QVector<Node> &nodes)
+{
+    QHash<QString, QVector<int> > drivers, readers; //signal to the nodes that drive or read it
+    QHash<int, QHash<QString, int> > portIndex; //port names of the entities, built when first needed
+    int instanceCount = nodes.size();
+    for(int n=0; n<instanceCount; n++)
+    {
+        const Instance &instance = instanceList[nodes[n].instance];
+        int b = blockIndex.value(instance.entity, -1);
+        QList<Port> ports;
+        if(b>=0)
+        {
+            ports = blocks[b].portList();
+            if(!portIndex.contains(b))
+            {
+                QHash<QString, int> &index = portIndex[b];
+                for(int p=0; p<ports.size(); p++)
+                    index.insert(ports[p].name.toLower(), p);
+            }
+        }
+        for(int p=0; p<instance.portMap.size(); p++)
+        {
+            QString signal = signalName(instance.portMap[p].second);
+            if(signal.isEmpty())
+                continue;
+            int port = -1;
+            if(b>=0)
+                port = instance.portMap[p].first.isEmpty()?(p<ports.size()?p:-1):portIndex[b].value(instance.portMap[p].first, -1);
+            direction_t direction = port>=0?ports[port].direction:in; //unknown ports only read
+            if(direction==out || direction==buffer || direction==inout)
+                drivers[signal].append(n);
+            if(direction==in || direction==inout || direction==linkage)
+                readers[signal].append(n);
+        }
+    }
+
+    //Sorted, so the net nodes get the same numbers in every run
+    QStringList signalNames = drivers.keys();
+    std::sort(signalNames.begin(), signalNames.end());
+    QVector<QPair<int, int> > edges;
+    QSet<qint64> seen;
+    for(int s=0; s<signalNames.size(); s++)
+    {
+        const QVector<int> driving = drivers.value(signalNames[s]);
+        const QVector<int> reading = readers.value(signalNames[s]);
+        if(driving.size()*reading.size() <= driving.size()+reading.size())
+        {
+            for(int d=0; d<driving.size(); d++)
+                for(int r=0; r<reading.size(); r++)
+                    addEdge(edges, seen, driving[d], reading[r]);
+            continue;
+        }
+        //A bus with several drivers and readers, e.g. a shared inout: the drivers connect to one net node and the
+        //net to the readers, so the number of edges grows with the ports instead of drivers times readers
+        Node node;
+        node.instance = -1;
+        node.layer = node.order = 0;
+        node.barycenter = 0;
+        node.size = QSize(0, 0);
+        int net = nodes.size();
+        nodes.append(node);
+        QSet<int> driven;
+        for(int d=0; d<driving.size(); d++)
+        {
+            addEdge(edges, seen, driving[d], net);
+            driven.insert(driving[d]);
+        }
+        for(int r=0; r<reading.size(); r++)
+            if(!driven.contains(reading[r])) //an inout already meets the others at the net
+                addEdge(edges, seen, net, reading[r]);
+    }
+    return edges;
+}
+
+QSize Hierarchy::layout(QVector<Node> &nodes, const QVector<QPair<int, int> > &edges, int labelHeight)
+{
+    int n = nodes.size();
+
+    //Outgoing edges of every node, as edge indices in one array
+    QVector<int> outStart(n+1, 0);
+    QVector<int> outEdges(edges.size());
+    for(int e=0; e<edges.size(); e++)
+        outStart[edges[e].first+1]++;
+    for(int v=0; v<n; v++)
+        outStart[v+1] += outStart[v];
+    QVector<int> fill = outStart;
+    for(int e=0; e<edges.size(); e++)
+        outEdges[fill[edges[e].first]++] = e;
+
+    //Break the cycles: an edge back to a node on the depth first search stack is not used for layering
+    QVector<char> state(n, 0); //0 not visited, 1 on the stack, 2 done
+    QVector<char> backEdge(edges.size(), 0);
+    QVector<QPair<int, int> > stack; //node and its next outgoing edge
+    for(int s=0; s<n; s++)
+    {
+        if(state[s])
+            continue;
+        state[s] = 1;
+        stack.append(qMakePair(s, outStart[s]));
+        while(!stack.isEmpty())
+        {
+            int v = stack.last().first;
+            if(stack.last().second==outStart[v+1])
+            {
+                state[v] = 2;
+                stack.removeLast();
+                continue;
+            }
+            int e = outEdges[stack.last().second++];
+            int w = edges[e].second;
+            if(state[w]==1)
+                backEdge[e] = 1;
+            else if(state[w]==0)
+            {
+                state[w] = 1;
+                stack.append(qMakePair(w, outStart[w]));
+            }
+        }
+    }
+
+    //Longest path layering in topological order
+    QVector<int> inDegree(n, 0);
+    for(int e=0; e<edges.size(); e++)
+        if(!backEdge[e])
+            inDegree[edges[e].second]++;
+    QVector<int> queue;
+    for(int v=0; v<n; v++)
+    {
+        nodes[v].layer = 0;
+        if(inDegree[v]==0)
+            queue.append(v);
+    }
+    int layerCount = 1;
+    for(int q=0; q<queue.size(); q++)
+    {
+        int v = queue[q];
+        for(int i=outStart[v]; i<outStart[v+1]; i++)
+        {
+            int e = outEdges[i];
+            if(backEdge[e])
+                continue;
+            int w = edges[e].second;
+            nodes[w].layer = qMax(nodes[w].layer, nodes[v].layer+1);
+            if(--inDegree[w]==0)
+                queue.append(w);
+        }
+        layerCount = qMax(layerCount, nodes[v].layer+1);
+    }
+
+    //Neighbours in earlier and in later layers
+    QVector<QVector<int> > earlier(n), later(n);
+    for(int e=0; e<edges.size(); e++)
+    {
+        int u = edges[e].first;
+        int v = edges[e].second;
+        if(nodes[u].layer<nodes[v].layer)
+        {
+            later[u].append(v);
+            earlier[v].append(u);
+        }
+        else if(nodes[u].layer>nodes[v].layer)
+        {
+            later[v].append(u);
+            earlier[u].append(v);
+        }
+    }
+
+    QVector<QVector<int> > layers(layerCount);
+    for(int v=0; v<n; v++)
+        layers[nodes[v].layer].append(v);
+    QVector<double> position(n); //order within the layer, scaled to 0..1 so layers of different sizes compare
+    for(int l=0; l<layerCount; l++)
+    {
+        for(int i=0; i<layers[l].size(); i++)
+        {
+            nodes[layers[l][i]].order = i;
+            position[layers[l][i]] = (i+0.5)/layers[l].size();
+        }
+    }
+
+    //Barycenter ordering: sort every layer on the average position of its neighbours, alternately down and up
+    for(int sweep=0; sweep<8; sweep++)
+    {
+        bool down = (sweep%2)==0;
+        for(int step=1; step<layerCount; step++)
+        {
+            QVector<int> &layer = layers[down?step:layerCount-1-step];
+            QVector<QPair<double, int> > sorted(layer.size()); //barycenter and current order, so ties keep their order
+            for(int i=0; i<layer.size(); i++)
+            {
+                const QVector<int> &neighbours = down?earlier[layer[i]]:later[layer[i]];
+                double sum = 0;
+                for(int k=0; k<neighbours.size(); k++)
+                    sum += position[neighbours[k]];
+                nodes[layer[i]].barycenter = neighbours.isEmpty()?position[layer[i]]:sum/neighbours.size();
+                sorted[i] = qMakePair(nodes[layer[i]].barycenter, i);
+            }
+            std::sort(sorted.begin(), sorted.end());
+            QVector<int> previous = layer;
+            for(int i=0; i<layer.size(); i++)
+            {
+                layer[i] = previous[sorted[i].second];
+                nodes[layer[i]].order = i;
+                position[layer[i]] = (i+0.5)/layer.size();
+            }
+        }
+    }
+
+    //Layers are columns from left to right, every column is centered vertically
+    QVector<int> layerHeight(layerCount, 0);
+    QVector<int> layerWidth(layerCount, 0);
+    int height = 0;
+    for(int l=0; l<layerCount; l++)
+    {
+        for(int i=0; i<layers[l].size(); i++)
+        {
+            const Node &node = nodes[layers[l][i]];
+            layerHeight[l] += node.size.height()+(node.instance<0?0:labelHeight)+(i>0?instanceGap:0);
+            layerWidth[l] = qMax(layerWidth[l], node.size.width());
+        }
+        height = qMax(height, layerHeight[l]);
+    }
+    int x = 0;
+    for(int l=0; l<layerCount; l++)
+    {
+        int y = (height-layerHeight[l])/2;
+        for(int i=0; i<layers[l].size(); i++)
+        {
+            Node &node = nodes[layers[l][i]];
+            node.rect = QRect(x, y, node.size.width(), node.size.height()+(node.instance<0?0:labelHeight)); //a net has no label
+            y += node.rect.height()+instanceGap;
+        }
+        x += layerWidth[l]+(l<layerCount-1?layerGap:0);
+    }
+    return QSize(x, height);
+}
+
+bool Hierarchy::write(QString fileName, QString entity)
+{
+    if(entity.isEmpty())
+        entity = top();
+    entity = entity.toLower();
+    QVector<Node> nodes;
+    for(int i=0; i<instanceList.size(); i++)
+    {
+        if(instanceList[i].parent!=entity)
+            continue;
+        Node node;
+        node.instance = i;
+        node.layer = node.order = 0;
+        node.barycenter = 0;
+        nodes.append(node);
+    }
+    if(nodes.isEmpty())
+    {
+        fprintf(stderr, "No instances found in the architecture of %s\n", entity.toLocal8Bit().data());
+        return false;
+    }
+
+    //Measure every entity once, on the same kind of device the diagram is drawn on. The blocks keep the measured
+    //labels, so painting the instances below does not measure them again
+    QBuffer scratch;
+    scratch.open(QIODevice::WriteOnly);
+    QSvgGenerator measureDevice;
+    measureDevice.setOutputDevice(&scratch);
+    QPainter measure(&measureDevice);
+    int labelHeight = measure.fontMetrics().height();
+    QHash<QString, QSize> sizes;
+    for(int n=0; n<nodes.size(); n++)
+    {
+        QString name = instanceList[nodes[n].instance].entity;
+        if(!sizes.contains(name))
+        {
+            int b = blockIndex.value(name, -1);
+            sizes.insert(name, b>=0?blocks[b].paintSymbol(measure):QSize(unknownWidth, unknownHeight));
+        }
+        nodes[n].size = sizes.value(name);
+    }
+    measure.end();
+
+    QVector<QPair<int, int> > edges = connect(nodes);
+    QSize size = layout(nodes, edges, labelHeight);
+
+    QByteArray svg;
+    QBuffer buffer(&svg);
+    buffer.open(QIODevice::WriteOnly);
+    QSvgGenerator generator;
+    generator.setOutputDevice(&buffer);
+    generator.setTitle(entity);
+    generator.setDescription("Hierarchy diagram generated from VHDL with entity-block.");
+    generator.setSize(QSize(size.width()+40, size.height()+40));
+    generator.setViewBox(QRect(-20, -20, size.width()+40, size.height()+40));
+    QPainter painter;
+    painter.begin(&generator);
+
+    //Connections first, so the symbols are drawn on top of them
+    QPen edgePen = painter.pen();
+    edgePen.setColor(edgeColor);
+    painter.setPen(edgePen);
+    for(int e=0; e<edges.size(); e++)
+    {
+        const QRect &from = nodes[edges[e].first].rect;
+        const QRect &to = nodes[edges[e].second].rect;
+        QPointF start(from.right()+1, from.center().y());
+        QPointF end(to.left(), to.center().y());
+        qreal bend = qMax(qreal(layerGap), qAbs(end.x()-start.x()))/2;
+        QPainterPath path;
+        path.moveTo(start);
+        path.cubicTo(start.x()+bend, start.y(), end.x()-bend, end.y(), end.x(), end.y());
+        painter.drawPath(path);
+    }
+
+    for(int n=0; n<nodes.size(); n++)
+    {
+        const QRect &rect = nodes[n].rect;
+        if(nodes[n].instance<0) //a net node is a junction of the connections
+        {
+            painter.setPen(edgePen);
+            painter.setBrush(edgeColor);
+            painter.drawEllipse(QPointF(rect.x(), rect.center().y()), 3, 3); //where the edges start and end
+            painter.setBrush(Qt::NoBrush);
+            continue;
+        }
+        const Instance &instance = instanceList[nodes[n].instance];
+        painter.setPen(QPen(Qt::black));
+        painter.drawText(rect.x(), rect.y(), rect.width(), labelHeight, Qt::AlignLeft, instance.label);
+        int b = blockIndex.value(instance.entity, -1);
+        painter.save();
+        painter.translate(rect.x(), rect.y()+labelHeight);
+        if(b>=0)
+            blocks[b].paintSymbol(painter);
+        else
+        {
+            painter.setPen(edgePen);
+            painter.drawRect(0, 0, unknownWidth, unknownHeight);
+            painter.drawText(0, 0, unknownWidth, unknownHeight, Qt::AlignCenter, instance.entity);
+        }
+        painter.restore();
+    }
+    painter.end();
+
+    if(!SvgWriter::publish(fileName, svg))
+    {
+        fprintf(stderr, "Could not write %s\n", fileName.toLocal8Bit().data());
+        return false;
+    }
+    return true;
+}
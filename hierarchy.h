@@ -0,0 +1,125 @@
+/**
+ *  This program creates an SVG (Scalable Vector Graphics) symbol out of
+ *  a VHDL entity
+ *
+ *  Copyright (C) 2019  Frans Schreuder info@schreuderelectronics.com
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef HIERARCHY_H
+#define HIERARCHY_H
+
+#include <QString>
+#include <QStringList>
+#include <QList>
+#include <QVector>
+#include <QHash>
+#include <QPair>
+#include <QSettings>
+#include <QColor>
+#include "entityblock.h"
+
+///A component or entity instantiation found in an architecture.
+class Instance
+{
+public:
+    QString label;
+    QString entity; ///instantiated entity, lower case
+    QString parent; ///entity of the architecture that contains the instantiation, lower case
+    QList<QPair<QString, QString> > portMap; ///formal port (lower case, empty if positional) and actual signal
+};
+
+/**
+ * @brief Hierarchy indexes the entities and instantiations in a set of VHDL files and draws the architecture of one
+ * entity as a block diagram: every instance is drawn with the symbol of its entity, instances that share a signal
+ * are connected from the instance that drives it to the instances that read it.
+ * The layout is layered, longest path layering after breaking cycles and barycenter ordering within the layers, which
+ * takes time linear in instances plus connections (times log for the sorting), so also very large top levels are fast.
+ */
+class Hierarchy
+{
+
+public:
+    /**
+     * @brief Hierarchy Constructor
+     * @param s colors and dimensions of the symbols, NULL for the defaults
+     * @param style layout of the symbols
+     */
+    Hierarchy(QSettings *s=NULL, symbol_style_t style=fullStyle);
+
+    /**
+     * @brief addFile indexes the entities and instantiations of a VHDL file
+     * @param fileName VHDL file, - for stdin
+     * @return false if the file could not be read
+     */
+    bool addFile(QString fileName);
+
+    /**
+     * @brief instances all instantiations found so far
+     */
+    QList<Instance> instances() const;
+
+    /**
+     * @brief top the entity whose architecture has the most instances, of the entities that are not instantiated
+     * themselves. Empty if no instantiations were found.
+     */
+    QString top() const;
+
+    /**
+     * @brief write draws the architecture of entity as block diagram
+     * @param fileName .svg file to write, - for stdout
+     * @param entity entity whose instances are drawn, top() if empty
+     * @return false if the entity has no instances or the file could not be written
+     */
+    bool write(QString fileName, QString entity="");
+
+private:
+    ///Instance of the diagram with its place in the layout.
+    struct Node
+    {
+        int instance; ///index in instanceList, -1 for a net node that joins the ports of a bus
+        int layer;
+        int order; ///position within the layer
+        double barycenter;
+        QSize size; ///size of the symbol, without the label
+        QRect rect; ///symbol and label in the diagram
+    };
+
+    void parseArchitectures(const QString &text);
+    void parsePortMap(const QString &map, Instance &instance);
+
+    /**
+     * @brief connect finds the connections between the nodes: from every port that drives a signal to every port
+     * that reads it, one edge per pair of nodes. Directions come from the indexed entities. A signal with several
+     * drivers and readers is routed through a net node that is appended to nodes, so the edges stay linear in the ports.
+     */
+    QVector<QPair<int, int> > connect(QVector<Node> &nodes);
+
+    /**
+     * @brief layout assigns layer, order and rect of every node
+     * @return size of the diagram
+     */
+    QSize layout(QVector<Node> &nodes, const QVector<QPair<int, int> > &edges, int labelHeight);
+
+    QSettings *settings;
+    symbol_style_t symbolStyle;
+    QColor edgeColor;
+    QList<EntityBlock> blocks;
+    QHash<QString, int> blockIndex; ///lower case entity name to index in blocks
+    QList<Instance> instanceList;
+};
+
+#endif // HIERARCHY_H
@@ -19,22 +19,34 @@
  */
 
 #include "entityblock.h"
+#include "batchrenderer.h"
+#include "entitymodel.h"
+#include "catalog.h"
+#include "hierarchy.h"
+#include "allocstats.h"
 #include <QApplication>
 #include <QFile>
 #include <QCommandLineParser>
+#include <QScopedPointer>
 #include <stdio.h>
 
 int main(int argc, char *argv[])
 {
-    QGuiApplication a(argc, argv);
+    //--check and --merge do not draw, they must also work without a display, so they do not get a QGuiApplication
+    bool noPainting = false;
+    for(int i=1; i<argc; i++)
+        if(QString::fromLocal8Bit(argv[i])=="--check"||QString::fromLocal8Bit(argv[i])=="--merge")
+            noPainting = true;
+    QScopedPointer<QCoreApplication> a(noPainting?new QCoreApplication(argc, argv):new QGuiApplication(argc, argv));
     QCoreApplication::setApplicationName("entity-block");
     QCoreApplication::setApplicationVersion("1.0");
     QCommandLineParser parser;
     parser.setApplicationDescription("Reads a vhdl file and outputs a .svg file with the entity block\n(All command line options will be stored)");
     parser.addHelpOption();
     parser.addVersionOption();
-    parser.addPositionalArgument("input", "VHDL file to convert");
-    parser.addPositionalArgument("output", "SVG file to output");
+    parser.addPositionalArgument("input", "VHDL file to convert, - for stdin");
+    parser.addPositionalArgument("output", "SVG file to output, - for stdout");
+    parser.addPositionalArgument("[inputs...]", "More VHDL files to convert, only with --output-dir, --archive, --frames, --check, --merge or --hierarchy");
 
     QCommandLineOption commentColorOption(QStringList() << "c" << "comment-color",
             "Change default comment color to <color>",
@@ -76,7 +88,83 @@ int main(int argc, char *argv[])
             "number");
 
     QCommandLineOption simplifiedSymbol(QStringList() << "S" << "symplified-symbol",
-            "Generate a symbol without types, comments and generics");
+            "Generate a symbol without types, comments and generics, same as --style minimal");
+
+    QCommandLineOption styleOption(QStringList() << "style",
+            "Layout of the symbol: full (default), minimal (names only) or compact (one line per port, no comments)",
+            "style", "full");
+
+    QCommandLineOption outputDirOption(QStringList() << "o" << "output-dir",
+            "Convert every input file, store the symbols in <directory> named after the entity",
+            "directory");
+
+    QCommandLineOption jobsOption(QStringList() << "j" << "jobs",
+            "Render with <number> threads when using --output-dir (default: one per core)",
+            "number");
+
+    QCommandLineOption svgzOption(QStringList() << "z" << "svgz",
+            "Store gzip compressed .svgz files");
+
+    QCommandLineOption archiveOption(QStringList() << "a" << "archive",
+            "Convert every input file, store all symbols in a single .tar or .tar.gz <file>",
+            "file");
+
+    QCommandLineOption framesOption(QStringList() << "f" << "frames",
+            "Convert every entity of every input file and write them to stdout, each as a line \"<entity> <size>\" followed by the .svg data");
+
+    QCommandLineOption exportJsonOption(QStringList() << "export-json",
+            "Also write the parsed entities (libraries, generics, ports) as JSON lines to <file>, - for stdout",
+            "file");
+
+    QCommandLineOption exportBinaryOption(QStringList() << "export-binary",
+            "Also write the parsed entities in the binary entity model format (see entitymodel.h) to <file>",
+            "file");
+
+    QCommandLineOption catalogOption(QStringList() << "catalog",
+            "Also write a browsable HTML <file> with a search index and lazily loaded thumbnails of all symbols, "
+            "not with --archive, --frames or --svgz",
+            "file");
+
+    QCommandLineOption compactOption(QStringList() << "compact",
+            "Write minified symbols: merged styles, CSS classes and rounded coordinates");
+
+    QCommandLineOption precisionOption(QStringList() << "precision",
+            "Round coordinates to <digits> decimals with --compact (default 1)",
+            "digits", "1");
+
+    QCommandLineOption checkOption(QStringList() << "check",
+            "Only parse every input file and report malformed declarations, without drawing anything");
+
+    QCommandLineOption shardOption(QStringList() << "shard",
+            "Only convert shard <i> of <n> (1 to n) of the input files, balanced on file size, to split a batch over machines. "
+            "Only with --output-dir, --archive or --check",
+            "i/n");
+
+    QCommandLineOption manifestOption(QStringList() << "manifest",
+            "Also write a JSON <file> listing all symbols, which --merge can combine, not with --archive or --frames",
+            "file");
+
+    QCommandLineOption mergeOption(QStringList() << "merge",
+            "Combine the manifests given as input files into one --manifest and/or --catalog");
+
+    QCommandLineOption hierarchyOption(QStringList() << "hierarchy",
+            "Draw the instances in the architecture of the --top entity, found in all input files, as block diagram in <file>",
+            "file");
+
+    QCommandLineOption topOption(QStringList() << "top",
+            "Entity for --hierarchy (default: the entity that is not instantiated and has the most instances)",
+            "entity");
+
+    QCommandLineOption statsOption(QStringList() << "stats",
+            "Report allocations, allocated bytes and peak live bytes per phase on stderr (needs a build with ENTITYBLOCK_ALLOC_STATS)");
+
+    QCommandLineOption statsJsonOption(QStringList() << "stats-json",
+            "Also write the allocation statistics of --stats as JSON to <file>",
+            "file");
+
+    QCommandLineOption geometryOption(QStringList() << "geometry",
+            "Also write a .json file next to every symbol with the image size, the box and the anchor point of every port, "
+            "not with --frames or --hierarchy");
 
     parser.addOption(commentColorOption);
     parser.addOption(portNameColorOption);
@@ -91,15 +179,37 @@ int main(int argc, char *argv[])
     parser.addOption(shadowColorOption);
     parser.addOption(borderWidthOption);
     parser.addOption(simplifiedSymbol);
+    parser.addOption(styleOption);
+    parser.addOption(outputDirOption);
+    parser.addOption(jobsOption);
+    parser.addOption(svgzOption);
+    parser.addOption(archiveOption);
+    parser.addOption(framesOption);
+    parser.addOption(exportJsonOption);
+    parser.addOption(exportBinaryOption);
+    parser.addOption(catalogOption);
+    parser.addOption(compactOption);
+    parser.addOption(precisionOption);
+    parser.addOption(checkOption);
+    parser.addOption(shardOption);
+    parser.addOption(manifestOption);
+    parser.addOption(mergeOption);
+    parser.addOption(hierarchyOption);
+    parser.addOption(topOption);
+    parser.addOption(statsOption);
+    parser.addOption(statsJsonOption);
+    parser.addOption(geometryOption);
 
     // Process the actual command line arguments given by the user
-    parser.process(a);
+    parser.process(*a);
 
 
-    const QStringList args = parser.positionalArguments();
+    QStringList args = parser.positionalArguments();
     QString fileName;
     QString outputName;
-    if(args.size()<1||args.size()>2)
+    bool batchMode = parser.isSet(outputDirOption)||parser.isSet(archiveOption)||parser.isSet(framesOption)||
+            parser.isSet(checkOption)||parser.isSet(mergeOption)||parser.isSet(hierarchyOption);
+    if(args.size()<1||(args.size()>2&&!batchMode))
     {
         parser.showHelp();
         return 1;
@@ -110,7 +220,50 @@ int main(int argc, char *argv[])
         if(args.size()>1)
             outputName = args[1];
     }
+    if(parser.isSet(framesOption) && (parser.value(exportJsonOption)=="-" || parser.value(exportBinaryOption)=="-"))
+    {
+        fprintf(stderr, "--frames writes to stdout, the model export needs a file name\n");
+        return 1;
+    }
+    if(parser.isSet(geometryOption) && (parser.isSet(framesOption)||parser.isSet(hierarchyOption)))
+    {
+        fprintf(stderr, "--geometry writes a file next to every symbol, not with --frames or --hierarchy\n");
+        return 1;
+    }
+    //The catalog links to the symbol files, they must exist next to it and a browser must show them from file://
+    if((parser.isSet(catalogOption)||parser.isSet(manifestOption)) && (parser.isSet(framesOption)||parser.isSet(archiveOption)))
+    {
+        fprintf(stderr, "--catalog and --manifest need symbol files, not --frames or --archive\n");
+        return 1;
+    }
+    if(parser.isSet(catalogOption) && parser.isSet(svgzOption))
+    {
+        fprintf(stderr, "--catalog cannot show .svgz thumbnails, leave out --svgz\n");
+        return 1;
+    }
+
 
+    symbol_style_t style = fullStyle;
+    if(parser.isSet(simplifiedSymbol))
+        style = minimalStyle;
+    else
+    {
+        QString styleName = parser.value(styleOption).toLower();
+        bool found = false;
+        for(int i=0; i<3; i++)
+        {
+            if(styleName == style_names[i])
+            {
+                style = symbol_style_t(i);
+                found = true;
+            }
+        }
+        if(!found)
+        {
+            fprintf(stderr, "Unknown style %s, use full, minimal or compact\n", styleName.toLocal8Bit().data());
+            return 1;
+        }
+    }
 
     QSettings *settings = new QSettings("Schreuder Electronics","entity-block");
     if(parser.isSet(commentColorOption))
@@ -180,8 +333,116 @@ int main(int argc, char *argv[])
         settings->setValue("Dimensions/borderWidth",c);
     }
 
-    EntityBlock w(fileName,outputName, settings, parser.isSet(simplifiedSymbol));
+    int compactPrecision = -1;
+    if(parser.isSet(compactOption))
+    {
+        bool ok;
+        compactPrecision = parser.value(precisionOption).toInt(&ok);
+        if(!ok || compactPrecision < 0) compactPrecision = 1;
+    }
+
+    if(parser.isSet(shardOption))
+    {
+        //A single file has no shards, and a hierarchy or a merge needs all of its inputs
+        if(!parser.isSet(outputDirOption) && !parser.isSet(archiveOption) && !parser.isSet(checkOption))
+        {
+            fprintf(stderr, "--shard only works with --output-dir, --archive or --check\n");
+            return 1;
+        }
+        QStringList shard = parser.value(shardOption).split("/");
+        int index = shard.value(0).toInt();
+        int count = shard.value(1).toInt();
+        if(shard.size()!=2 || count<1 || index<1 || index>count)
+        {
+            fprintf(stderr, "--shard needs <i>/<n> with 1 <= i <= n\n");
+            return 1;
+        }
+        args = BatchRenderer::selectShard(args, index-1, count);
+    }
+
+    EntityModelExport modelExport;
+    Catalog catalog;
+    bool exportModel = parser.isSet(exportJsonOption)||parser.isSet(exportBinaryOption);
+    bool collectCatalog = parser.isSet(catalogOption)||parser.isSet(manifestOption);
+    bool ok = true;
+    if(parser.isSet(mergeOption))
+    {
+        for(int i=0; i<args.size(); i++)
+        {
+            if(!catalog.loadManifest(args[i], i))
+            {
+                fprintf(stderr, "Could not read manifest %s\n", args[i].toLocal8Bit().data());
+                ok = false;
+            }
+        }
+    }
+    else if(parser.isSet(hierarchyOption))
+    {
+        Hierarchy hierarchy(settings, style);
+        for(int i=0; i<args.size(); i++)
+        {
+            if(!hierarchy.addFile(args[i]))
+            {
+                fprintf(stderr, "Could not open %s\n", args[i].toLocal8Bit().data());
+                ok = false;
+            }
+        }
+        if(!hierarchy.write(parser.value(hierarchyOption), parser.value(topOption)))
+            ok = false;
+    }
+    else if(batchMode)
+    {
+        int jobs = parser.value(jobsOption).toInt();
+        BatchRenderer batch(settings, style, parser.value(outputDirOption), jobs);
+        batch.setCompressed(parser.isSet(svgzOption));
+        batch.setCompactPrecision(compactPrecision);
+        batch.setGeometrySidecar(parser.isSet(geometryOption));
+        if(parser.isSet(archiveOption))
+            batch.setArchive(parser.value(archiveOption));
+        if(exportModel)
+            batch.setModelExport(&modelExport);
+        if(collectCatalog)
+            batch.setCatalog(&catalog);
+        if(parser.isSet(checkOption))
+            ok = batch.check(args);
+        else if(parser.isSet(framesOption))
+            ok = batch.renderFrames(args);
+        else
+            ok = batch.render(args);
+    }
+    else
+    {
+        EntityBlock w("", "", settings, style, parser.isSet(svgzOption), compactPrecision);
+        w.setGeometrySidecar(parser.isSet(geometryOption));
+        ok = false;
+        if(!w.loadFile(fileName))
+            fprintf(stderr, "Could not open %s\n", fileName.toLocal8Bit().data());
+        else if(w.name().isEmpty())
+            fprintf(stderr, "Could not read an entity from %s\n", fileName.toLocal8Bit().data());
+        else if(!w.saveSvg(outputName))
+            fprintf(stderr, "Could not write %s\n", w.svgPath(outputName).toLocal8Bit().data());
+        else
+            ok = true;
+        if(ok && exportModel)
+            modelExport.add(0, 0, w);
+        if(ok && collectCatalog)
+            catalog.add(0, 0, w, w.svgPath(outputName));
+    }
     delete settings;
 
-    return w.success?0:1;
+    if(parser.isSet(exportJsonOption) && !modelExport.writeJson(parser.value(exportJsonOption)))
+        ok = false;
+    if(parser.isSet(exportBinaryOption) && !modelExport.writeBinary(parser.value(exportBinaryOption)))
+        ok = false;
+    if(parser.isSet(manifestOption) && !catalog.writeManifest(parser.value(manifestOption)))
+        ok = false;
+    if(parser.isSet(catalogOption) && !catalog.write(parser.value(catalogOption)))
+        ok = false;
+
+    if(parser.isSet(statsOption))
+        AllocStats::report();
+    if(parser.isSet(statsJsonOption) && !AllocStats::writeJson(parser.value(statsJsonOption)))
+        ok = false;
+
+    return ok?0:1;
 }
@@ -0,0 +1,143 @@
+/**
+ *  This program creates an SVG (Scalable Vector Graphics) symbol out of
+ *  a VHDL entity
+ *
+ *  Copyright (C) 2019  Frans Schreuder info@schreuderelectronics.com
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "structuralindex.h"
+#include "allocstats.h"
+#include <QtAlgorithms>
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+///Scalar classification of n characters, bit i of the result is set for a structural character at data[i].
+static quint64 classifyScalar(const ushort *data, int n)
+{
+    quint64 bits = 0;
+    for(int i=0; i<n; i++)
+    {
+        ushort c = data[i];
+        if(c=='-' || c=='\n' || c=='(' || c==')' || c==';' || c==':')
+            bits |= quint64(1) << i;
+    }
+    return bits;
+}
+
+#if defined(__AVX2__)
+///Classifies 32 characters at once.
+static quint32 classify32(const ushort *data)
+{
+    __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data));
+    __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data+16));
+    __m256i ma = _mm256_setzero_si256();
+    __m256i mb = _mm256_setzero_si256();
+    const ushort chars[] = {'-', '\n', '(', ')', ';', ':'};
+    for(int i=0; i<6; i++)
+    {
+        __m256i c = _mm256_set1_epi16(chars[i]);
+        ma = _mm256_or_si256(ma, _mm256_cmpeq_epi16(a, c));
+        mb = _mm256_or_si256(mb, _mm256_cmpeq_epi16(b, c));
+    }
+    //pack the 16 bit masks to bytes, packs works per 128 bit lane so the quadwords need to be put back in order
+    __m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi16(ma, mb), 0xD8);
+    return quint32(_mm256_movemask_epi8(packed));
+}
+#elif defined(__SSE2__)
+///Classifies 16 characters at once.
+static quint32 classify16(const ushort *data)
+{
+    __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+    __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data+8));
+    __m128i ma = _mm_setzero_si128();
+    __m128i mb = _mm_setzero_si128();
+    const ushort chars[] = {'-', '\n', '(', ')', ';', ':'};
+    for(int i=0; i<6; i++)
+    {
+        __m128i c = _mm_set1_epi16(chars[i]);
+        ma = _mm_or_si128(ma, _mm_cmpeq_epi16(a, c));
+        mb = _mm_or_si128(mb, _mm_cmpeq_epi16(b, c));
+    }
+    return quint32(_mm_movemask_epi8(_mm_packs_epi16(ma, mb)));
+}
+#endif
+
+StructuralIndex::StructuralIndex(const QString &text) : text(text)
+{
+    PhaseScope scope(phaseClassify);
+    const ushort *data = text.utf16();
+    int length = text.length();
+    mask.resize((length+63)/64);
+    int full = length/64;
+    for(int w=0; w<full; w++)
+    {
+        const ushort *block = data + 64*w;
+#if defined(__AVX2__)
+        mask[w] = quint64(classify32(block)) | (quint64(classify32(block+32)) << 32);
+#elif defined(__SSE2__)
+        mask[w] = quint64(classify16(block)) |
+                  (quint64(classify16(block+16)) << 16) |
+                  (quint64(classify16(block+32)) << 32) |
+                  (quint64(classify16(block+48)) << 48);
+#else
+        mask[w] = classifyScalar(block, 64);
+#endif
+    }
+    if(length%64)
+        mask[full] = classifyScalar(data + 64*full, length%64);
+}
+
+int StructuralIndex::next(int from) const
+{
+    if(from < 0)
+        from = 0;
+    int w = from/64;
+    if(w >= mask.size())
+        return -1;
+    quint64 bits = mask[w] & (~quint64(0) << (from%64));
+    while(bits == 0)
+    {
+        if(++w >= mask.size())
+            return -1;
+        bits = mask[w];
+    }
+    return w*64 + qCountTrailingZeroBits(bits);
+}
+
+bool StructuralIndex::isComment(int position) const
+{
+    return position+1 < text.length() && text[position]=='-' && text[position+1]=='-';
+}
+
+int StructuralIndex::lineEnd(int from, int *codeEnd) const
+{
+    int comment = -1;
+    for(int p=next(from); p!=-1; p=next(p+1))
+    {
+        if(text[p]=='\n')
+        {
+            if(codeEnd)
+                *codeEnd = comment==-1?p:comment;
+            return p;
+        }
+        if(comment==-1 && isComment(p))
+            comment = p;
+    }
+    if(codeEnd)
+        *codeEnd = comment==-1?text.length():comment;
+    return text.length();
+}
@@ -0,0 +1,64 @@
+/**
+ *  This program creates an SVG (Scalable Vector Graphics) symbol out of
+ *  a VHDL entity
+ *
+ *  Copyright (C) 2019  Frans Schreuder info@schreuderelectronics.com
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef STRUCTURALINDEX_H
+#define STRUCTURALINDEX_H
+
+#include <QString>
+#include <QVector>
+
+/**
+ * @brief StructuralIndex marks the positions of the characters that matter for parsing VHDL: - \n ( ) ; :
+ * The text is classified in one pass (SSE2 or AVX2 when the compiler targets it, scalar otherwise) into a bitmask
+ * with one bit per character. Bracket matching and comment skipping then only visit the marked positions.
+ */
+class StructuralIndex
+{
+
+public:
+    /**
+     * @brief StructuralIndex Constructor, classifies the whole text. text must outlive the index.
+     */
+    StructuralIndex(const QString &text);
+
+    /**
+     * @brief next position of the first structural character at or after from
+     * @return position in the text, -1 if there is none
+     */
+    int next(int from) const;
+
+    /**
+     * @brief isComment true if there is a VHDL comment (--) starting at position
+     */
+    bool isComment(int position) const;
+
+    /**
+     * @brief lineEnd position of the newline that ends the line containing from, or the length of the text
+     * @param codeEnd if not NULL, receives the position where a comment starts on that line, or the line end
+     */
+    int lineEnd(int from, int *codeEnd = NULL) const;
+
+private:
+    const QString &text;
+    QVector<quint64> mask;
+};
+
+#endif // STRUCTURALINDEX_H
@@ -0,0 +1,257 @@
+/**
+ *  This program creates an SVG (Scalable Vector Graphics) symbol out of
+ *  a VHDL entity
+ *
+ *  Copyright (C) 2019  Frans Schreuder info@schreuderelectronics.com
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "svgminifier.h"
+#include <QXmlStreamReader>
+#include <QRegularExpression>
+#include <QStringList>
+#include <QStack>
+#include <QHash>
+#include <QList>
+#include <QPair>
+
+typedef QList<QPair<QString, QString> > AttributeList;
+
+///Attributes that hold coordinates or lengths, their numbers are rounded.
+static bool isGeometry(const QString &name)
+{
+    static const QStringList names = QStringList() << "x" << "y" << "x1" << "y1" << "x2" << "y2" << "cx" << "cy" <<
+        "r" << "rx" << "ry" << "width" << "height" << "d" << "points" << "transform" << "viewBox" << "stroke-width";
+    return names.contains(name);
+}
+
+///Attributes that are inherited from a group, on groups these are moved to a CSS class.
+static bool isPresentation(const QString &name)
+{
+    static const QStringList names = QStringList() << "fill" << "fill-opacity" << "fill-rule" << "stroke" <<
+        "stroke-opacity" << "stroke-width" << "stroke-linecap" << "stroke-linejoin" << "stroke-miterlimit" <<
+        "stroke-dasharray" << "stroke-dashoffset" << "font-family" << "font-size" << "font-weight" <<
+        "font-style";
+    return names.contains(name);
+}
+
+///Inherited values at the root of the document, as a renderer assumes them.
+static QHash<QString, QString> defaultStyle()
+{
+    QHash<QString, QString> style;
+    style.insert("fill-opacity", "1");
+    style.insert("stroke-opacity", "1");
+    style.insert("fill-rule", "nonzero");
+    style.insert("font-style", "normal");
+    style.insert("font-weight", "400");
+    return style;
+}
+
+///True if a not inherited attribute only states what a renderer would assume anyway.
+static bool isRedundant(const QString &name, const QString &value)
+{
+    return (name=="vector-effect" && value=="none") ||
+           (name=="stop-opacity" && value=="1") ||
+           (name=="transform" && value=="matrix(1,0,0,1,0,0)") ||
+           name=="version" || name=="baseProfile"; //the tiny profile does not allow <style>
+}
+
+static QString roundNumbers(const QString &value, int precision)
+{
+    static const QRegularExpression number("-?(\\d+\\.?\\d*|\\.\\d+)([eE][-+]?\\d+)?");
+    QString result;
+    int last = 0;
+    QRegularExpressionMatchIterator it = number.globalMatch(value);
+    while(it.hasNext())
+    {
+        QRegularExpressionMatch m = it.next();
+        QString n = QString::number(m.captured(0).toDouble(), 'f', precision);
+        if(n.contains('.'))
+        {
+            while(n.endsWith('0'))
+                n.chop(1);
+            if(n.endsWith('.'))
+                n.chop(1);
+        }
+        if(n=="-0")
+            n = "0";
+        result += value.mid(last, m.capturedStart(0)-last);
+        result += n;
+        last = m.capturedEnd(0);
+    }
+    result += value.mid(last);
+    return result;
+}
+
+///CSS needs units where presentation attributes do not, and quotes around font names with spaces.
+static QString cssValue(const QString &name, const QString &value)
+{
+    bool isNumber;
+    value.toDouble(&isNumber);
+    if(isNumber && (name=="font-size" || name=="stroke-width" || name=="stroke-dashoffset"))
+        return value + "px";
+    if(name=="font-family" && value.contains(' ') && !value.contains('\'') && !value.contains('"'))
+        return "'" + value + "'";
+    return value;
+}
+
+static QByteArray escaped(const QString &s)
+{
+    return s.toHtmlEscaped().toUtf8();
+}
+
+QByteArray SvgMinifier::minify(const QByteArray &svg, int precision)
+{
+    QXmlStreamReader xml(svg);
+    xml.setNamespaceProcessing(false); //keeps the xmlns declarations as plain attributes
+
+    QByteArray out;
+    QHash<QString, QString> classes; //CSS declarations -> class name
+    QByteArray css;
+    QStack<QString> keys; //per open element: class and remaining attributes for groups, empty otherwise
+    QStack<QString> names;
+    QStack<QHash<QString, QString> > inherited; //per open element: presentation attributes that apply to its children
+    bool tagOpen = false; //the > of the last start tag is not written yet, so it can still become />
+    bool closePending = false; //a </g> that is held back, to merge it with an identical next group
+    QString pendingKey;
+    int styleInsert = -1;
+    int textDepth = 0; //inside text, title or desc whitespace matters
+
+    while(!xml.atEnd())
+    {
+        xml.readNext();
+        if(xml.isStartElement())
+        {
+            QString name = xml.qualifiedName().toString();
+            AttributeList attributes;
+            QStringList declarations;
+            QHash<QString, QString> style = inherited.isEmpty()?defaultStyle():inherited.top();
+            foreach(const QXmlStreamAttribute &a, xml.attributes())
+            {
+                QString aName = a.qualifiedName().toString();
+                QString value = a.value().toString();
+                if(isGeometry(aName))
+                    value = roundNumbers(value, precision);
+                if(isRedundant(aName, value))
+                    continue;
+                if(isPresentation(aName))
+                {
+                    if(style.value(aName)==value)
+                        continue; //the same as what is inherited anyway, e.g. the font of every text run
+                    style.insert(aName, value);
+                }
+                if(name=="g" && isPresentation(aName))
+                    declarations << aName + ":" + cssValue(aName, value);
+                else
+                    attributes << qMakePair(aName, value);
+            }
+            QString key;
+            if(name=="g")
+            {
+                QString declaration = declarations.join(";");
+                if(!declaration.isEmpty())
+                {
+                    if(!classes.contains(declaration))
+                    {
+                        QString c = "s" + QString::number(classes.size(), 36);
+                        classes.insert(declaration, c);
+                        css += "." + c.toUtf8() + "{" + escaped(declaration) + "}";
+                    }
+                    attributes.prepend(qMakePair(QString("class"), classes.value(declaration)));
+                }
+                for(int i=0; i<attributes.size(); i++)
+                    key += attributes[i].first + "=" + attributes[i].second + "\n";
+            }
+
+            if(closePending)
+            {
+                closePending = false;
+                if(name=="g" && key==pendingKey) //same style as the group that was just closed: continue that one
+                {
+                    names.push(name);
+                    keys.push(key);
+                    inherited.push(style);
+                    continue;
+                }
+                out += "</g>";
+            }
+            if(tagOpen)
+            {
+                out += ">";
+                tagOpen = false;
+                if(names.size()==1)
+                    styleInsert = out.size();
+            }
+            out += "<" + name.toUtf8();
+            for(int i=0; i<attributes.size(); i++)
+                out += " " + attributes[i].first.toUtf8() + "=\"" + escaped(attributes[i].second) + "\"";
+            tagOpen = true;
+            names.push(name);
+            keys.push(key);
+            inherited.push(style);
+            if(name=="text" || name=="title" || name=="desc")
+                textDepth++;
+        }
+        else if(xml.isEndElement())
+        {
+            if(closePending)
+            {
+                out += "</g>";
+                closePending = false;
+            }
+            QString name = names.pop();
+            QString key = keys.pop();
+            inherited.pop();
+            if(name=="text" || name=="title" || name=="desc")
+                textDepth--;
+            if(tagOpen)
+            {
+                out += "/>";
+                tagOpen = false;
+            }
+            else if(name=="g")
+            {
+                closePending = true;
+                pendingKey = key;
+            }
+            else
+                out += "</" + name.toUtf8() + ">";
+        }
+        else if(xml.isCharacters())
+        {
+            if(textDepth==0 && xml.isWhitespace())
+                continue;
+            if(closePending)
+            {
+                out += "</g>";
+                closePending = false;
+            }
+            if(tagOpen)
+            {
+                out += ">";
+                tagOpen = false;
+                if(names.size()==1)
+                    styleInsert = out.size();
+            }
+            out += escaped(xml.text().toString());
+        }
+    }
+    if(xml.hasError() || styleInsert<0)
+        return svg;
+    if(!css.isEmpty())
+        out.insert(styleInsert, "<style>" + css + "</style>");
+    out += "\n";
+    return out;
+}
@@ -0,0 +1,45 @@
+/**
+ *  This program creates an SVG (Scalable Vector Graphics) symbol out of
+ *  a VHDL entity
+ *
+ *  Copyright (C) 2019  Frans Schreuder info@schreuderelectronics.com
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef SVGMINIFIER_H
+#define SVGMINIFIER_H
+
+#include <QByteArray>
+
+/**
+ * @brief SvgMinifier rewrites the verbose output of QSvgGenerator into a much smaller, equivalent .svg:
+ * consecutive groups with the same style are merged, group styles become short CSS classes,
+ * coordinates are rounded and attributes that only repeat the default value are dropped.
+ */
+class SvgMinifier
+{
+
+public:
+    /**
+     * @brief minify
+     * @param svg .svg file as written by QSvgGenerator
+     * @param precision number of decimals kept in coordinates
+     * @return the compact .svg file, or svg itself if it could not be parsed
+     */
+    static QByteArray minify(const QByteArray &svg, int precision = 1);
+};
+
+#endif // SVGMINIFIER_H
@@ -0,0 +1,296 @@
+/**
+ *  This program creates an SVG (Scalable Vector Graphics) symbol out of
+ *  a VHDL entity
+ *
+ *  Copyright (C) 2019  Frans Schreuder info@schreuderelectronics.com
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "svgwriter.h"
+#include "archive.h"
+#include "allocstats.h"
+#include <stdio.h>
+#include <QSaveFile>
+#include <QFile>
+#include <QHash>
+#include <QMutexLocker>
+
+SvgWriter::SvgWriter(int maxQueued)
+{
+    this->maxQueued = maxQueued>0?maxQueued:1;
+    finishing = false;
+    archiveFile = NULL;
+    tar = NULL;
+    heldBytes = 0;
+    nextFile = 0;
+    nextEntity = 0;
+}
+
+SvgWriter::~SvgWriter()
+{
+    finish();
+}
+
+///Files held back for the order of an archive, above this the entities after the awaited one wait
+static const qint64 maxHeldBytes = 64*1024*1024;
+
+bool SvgWriter::mustWait(const Job &job) const
+{
+    if(queue.size() >= maxQueued) //backpressure: wait until the writer has taken the queue
+        return true;
+    if(!tar || job.kind != fileJob || job.file < 0 || heldBytes <= maxHeldBytes)
+        return false;
+    //Only wait for an entity that is being rendered, one that still waits for a thread would never come
+    QPair<int, int> next(nextFile, nextEntity);
+    return QPair<int, int>(job.file, job.entity) != next && running.contains(next);
+}
+
+void SvgWriter::push(const Job &job)
+{
+    QMutexLocker locker(&mutex);
+    while(mustWait(job))
+        notFull.wait(&mutex);
+    queue.append(job);
+    notEmpty.wakeOne();
+}
+
+void SvgWriter::enqueue(QString path, QByteArray data, int file, int entity)
+{
+    Job job;
+    job.kind = fileJob;
+    job.path = path;
+    job.data = data;
+    job.file = file;
+    job.entity = entity;
+    push(job);
+}
+
+void SvgWriter::setEntityCount(int file, int count)
+{
+    Job job;
+    job.kind = countJob;
+    job.file = file;
+    job.entity = count;
+    push(job);
+}
+
+void SvgWriter::entityStarted(int file, int entity)
+{
+    QMutexLocker locker(&mutex);
+    running.insert(qMakePair(file, entity));
+}
+
+void SvgWriter::entityDone(int file, int entity)
+{
+    mutex.lock();
+    running.remove(qMakePair(file, entity));
+    mutex.unlock();
+    Job job;
+    job.kind = doneJob;
+    job.file = file;
+    job.entity = entity;
+    push(job);
+}
+
+void SvgWriter::finish()
+{
+    mutex.lock();
+    finishing = true;
+    notEmpty.wakeAll();
+    mutex.unlock();
+    wait();
+    if(archiveFile)
+    {
+        if(!tar->close() || !archiveFile->commit())
+        {
+            fprintf(stderr, "Could not write %s\n", archiveFile->fileName().toLocal8Bit().data());
+            failureCount.ref();
+        }
+        delete tar;
+        delete archiveFile;
+        tar = NULL;
+        archiveFile = NULL;
+    }
+}
+
+bool SvgWriter::setArchive(QString fileName, qint64 modificationTime)
+{
+    archiveFile = new QSaveFile(fileName);
+    if(!archiveFile->open(QIODevice::WriteOnly))
+    {
+        delete archiveFile;
+        archiveFile = NULL;
+        return false;
+    }
+    bool compressed = fileName.endsWith(".tar.gz", Qt::CaseInsensitive) || fileName.endsWith(".tgz", Qt::CaseInsensitive);
+    tar = new TarWriter(archiveFile, compressed);
+    tar->setModificationTime(modificationTime);
+    return true;
+}
+
+int SvgWriter::failures() const
+{
+    return failureCount.load();
+}
+
+QStringList SvgWriter::failedPaths() const
+{
+    return failed;
+}
+
+bool SvgWriter::publish(QString path, const QByteArray &data)
+{
+    PhaseScope scope(phaseWrite);
+    if(path == "-")
+    {
+        QFile out;
+        if(!out.open(stdout, QIODevice::WriteOnly))
+            return false;
+        return out.write(data) == data.size() && out.flush();
+    }
+    QSaveFile file(path);
+    if(!file.open(QIODevice::WriteOnly))
+        return false;
+    file.write(data);
+    return file.commit(); //renames the temporary file over path, or removes it if writing failed
+}
+
+QPair<int, int> SvgWriter::order(const Job &job)
+{
+    return qMakePair(job.file, job.entity);
+}
+
+void SvgWriter::writeFiles(const QList<Job> &jobs)
+{
+    //Coalesce: a later buffer for the same path replaces an earlier one that was not written yet. When entities
+    //have the same name, later is the higher (file, entity), also across batches, so the survivor does not depend
+    //on which thread finished first
+    QHash<QString, int> last;
+    for(int i=0; i<jobs.size(); i++)
+    {
+        if(jobs[i].kind != fileJob)
+            continue;
+        int previous = last.value(jobs[i].path, -1);
+        if(previous==-1 || !(order(jobs[i]) < order(jobs[previous])))
+            last[jobs[i].path] = i;
+    }
+    for(int i=0; i<jobs.size(); i++)
+    {
+        if(jobs[i].kind != fileJob || last.value(jobs[i].path) != i)
+            continue;
+        if(written.contains(jobs[i].path) && order(jobs[i]) < written.value(jobs[i].path))
+            continue;
+        written.insert(jobs[i].path, order(jobs[i]));
+        if(!publish(jobs[i].path, jobs[i].data))
+        {
+            fprintf(stderr, "Could not write %s\n", jobs[i].path.toLocal8Bit().data());
+            failureCount.ref();
+            failed.append(jobs[i].path);
+        }
+    }
+}
+
+void SvgWriter::addToArchive(const Job &job)
+{
+    if(!tar->addFile(job.path, job.data))
+    {
+        fprintf(stderr, "Could not write %s\n", job.path.toLocal8Bit().data());
+        failureCount.ref();
+        failed.append(job.path);
+    }
+}
+
+void SvgWriter::writeArchive(const QList<Job> &jobs)
+{
+    qint64 heldChange = 0;
+    //Not coalesced: which buffers meet in one batch depends on the timing, a duplicate name is simply stored twice
+    for(int i=0; i<jobs.size(); i++)
+    {
+        QPair<int, int> key(jobs[i].file, jobs[i].entity);
+        if(jobs[i].kind == countJob)
+            entityCounts[jobs[i].file] = jobs[i].entity;
+        else if(jobs[i].file < 0)
+            addToArchive(jobs[i]);
+        else if(jobs[i].kind == doneJob)
+            done.insert(key);
+        else
+        {
+            held[key].append(jobs[i]);
+            heldChange += jobs[i].data.size();
+        }
+    }
+
+    //Add the entities that are done, in order, up to the first one that is still being rendered
+    int file = nextFile;
+    int entity = nextEntity;
+    while(entityCounts.contains(file))
+    {
+        if(entity >= entityCounts.value(file))
+        {
+            file++;
+            entity = 0;
+            continue;
+        }
+        QPair<int, int> key(file, entity);
+        if(!done.remove(key))
+            break;
+        QList<Job> files = held.take(key);
+        for(int i=0; i<files.size(); i++)
+        {
+            addToArchive(files[i]);
+            heldChange -= files[i].data.size();
+        }
+        entity++;
+    }
+
+    mutex.lock();
+    heldBytes += heldChange;
+    nextFile = file;
+    nextEntity = entity;
+    notFull.wakeAll(); //the producers that waited for the previous entity
+    mutex.unlock();
+}
+
+void SvgWriter::run()
+{
+    PhaseScope scope(phaseWrite);
+    while(true)
+    {
+        QList<Job> jobs;
+        mutex.lock();
+        while(queue.isEmpty() && !finishing)
+            notEmpty.wait(&mutex);
+        if(queue.isEmpty()) //finishing and nothing left to write
+        {
+            mutex.unlock();
+            //whatever is still held, e.g. because an entity was never announced, in order
+            for(QMap<QPair<int, int>, QList<Job> >::const_iterator it=held.constBegin(); it!=held.constEnd(); ++it)
+            {
+                for(int i=0; i<it.value().size(); i++)
+                    addToArchive(it.value()[i]);
+            }
+            held.clear();
+            return;
+        }
+        jobs.swap(queue); //take everything that is waiting in one go
+        notFull.wakeAll();
+        mutex.unlock();
+
+        if(tar)
+            writeArchive(jobs);
+        else
+            writeFiles(jobs);
+    }
+}
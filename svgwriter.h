@@ -0,0 +1,165 @@
+/**
+ *  This program creates an SVG (Scalable Vector Graphics) symbol out of
+ *  a VHDL entity
+ *
+ *  Copyright (C) 2019  Frans Schreuder info@schreuderelectronics.com
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef SVGWRITER_H
+#define SVGWRITER_H
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QList>
+#include <QByteArray>
+#include <QStringList>
+#include <QAtomicInt>
+#include <QMap>
+#include <QSet>
+#include <QHash>
+#include <QPair>
+
+class QSaveFile;
+class TarWriter;
+
+/**
+ * @brief SvgWriter is the output stage of a batch: rendered images are handed over as in-memory buffers
+ * and written by this thread, so slow storage does not stall rendering.
+ * Every file is published atomically: it is written to a temporary file which is renamed over the target.
+ * In an archive the files of an entity are held back until all entities before it (in order of file and entity
+ * index) are done, so the archive does not depend on which thread finished first. While more than 64 MB
+ * are held, enqueue() also blocks for the entities after the one the archive waits for, as long as that one is
+ * being rendered.
+ */
+class SvgWriter : public QThread
+{
+
+public:
+    /**
+     * @brief SvgWriter Constructor, the thread is not started yet.
+     * @param maxQueued number of buffers that may be waiting before enqueue() blocks.
+     */
+    SvgWriter(int maxQueued = 16);
+    ~SvgWriter();
+
+    /**
+     * @brief enqueue hands a rendered file over to the writer thread.
+     * Blocks while the queue is full, so producers are throttled to the speed of the storage, and in an archive
+     * while too much is held back for an entity before this one.
+     * @param path target file name
+     * @param data complete contents of the file
+     * @param file index of the input file the image belongs to, -1 if it does not belong to an entity
+     * @param entity index of the entity in that file
+     */
+    void enqueue(QString path, QByteArray data, int file=-1, int entity=-1);
+
+    /**
+     * @brief setEntityCount announces how many entities file has, 0 if it could not be read.
+     * Every entity of it must be finished with entityDone().
+     */
+    void setEntityCount(int file, int count);
+
+    /**
+     * @brief entityStarted the entity is being rendered, the files of the entities after it may wait for it.
+     */
+    void entityStarted(int file, int entity);
+
+    /**
+     * @brief entityDone all files of this entity are enqueued, also if there were none because it failed.
+     */
+    void entityDone(int file, int entity);
+
+    /**
+     * @brief setArchive collects all files in one tar archive instead of writing them separately.
+     * Must be called before the thread is started. A name ending in .tar.gz or .tgz gives a compressed archive.
+     * @param fileName archive to write, it is published when finish() is called
+     * @param modificationTime time stamp of the files in the archive, in seconds since 1970
+     * @return false if the archive could not be created
+     */
+    bool setArchive(QString fileName, qint64 modificationTime=0);
+
+    /**
+     * @brief finish writes everything that is still queued and stops the thread.
+     */
+    void finish();
+
+    /**
+     * @brief failures number of files that could not be written.
+     */
+    int failures() const;
+
+    /**
+     * @brief failedPaths the files that could not be written, valid after finish()
+     */
+    QStringList failedPaths() const;
+
+    /**
+     * @brief publish writes data to path through a temporary file and renames it, readers never see a partial file.
+     * A path of - writes to stdout.
+     * @return false if the file could not be written.
+     */
+    static bool publish(QString path, const QByteArray &data);
+
+protected:
+    void run() override;
+
+private:
+    typedef enum{fileJob, countJob, doneJob} job_kind_t;
+
+    struct Job
+    {
+        job_kind_t kind;
+        QString path;
+        QByteArray data;
+        int file;
+        int entity; ///number of entities for a countJob
+    };
+
+    ///file and entity of a job, the order of the archive
+    static QPair<int, int> order(const Job &job);
+    void push(const Job &job);
+    bool mustWait(const Job &job) const;
+    void writeFiles(const QList<Job> &jobs);
+    void writeArchive(const QList<Job> &jobs);
+    void addToArchive(const Job &job);
+
+    QList<Job> queue;
+    QMutex mutex;
+    QWaitCondition notEmpty;
+    QWaitCondition notFull;
+    int maxQueued;
+    bool finishing;
+    QAtomicInt failureCount;
+    QSaveFile *archiveFile;
+    TarWriter *tar;
+
+    //Only used by the writer thread
+    QHash<QString, QPair<int, int> > written; ///entity that wrote a path last
+    QStringList failed;
+    QMap<QPair<int, int>, QList<Job> > held; ///files of entities that wait for an entity before them
+    QSet<QPair<int, int> > done;
+    QHash<int, int> entityCounts;
+
+    //Shared with the producers, protected by mutex
+    QSet<QPair<int, int> > running; ///entities between entityStarted and entityDone
+    qint64 heldBytes;
+    int nextFile; ///entity the archive waits for
+    int nextEntity;
+};
+
+#endif // SVGWRITER_H
@@ -0,0 +1,58 @@
+/**
+ *  This program creates an SVG (Scalable Vector Graphics) symbol out of
+ *  a VHDL entity
+ *
+ *  Copyright (C) 2019  Frans Schreuder info@schreuderelectronics.com
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef SYMBOLSTYLE_H
+#define SYMBOLSTYLE_H
+
+/*
+ * Layout policies for EntityBlock::paint. paint() selects one policy per symbol and calls the measure and draw
+ * loops instantiated for it, so the flags below are compile time constants and the loops of one style contain no
+ * code of the others. A new style is a new struct here plus a case in EntityBlock::paint.
+ */
+
+///Port names outside the box, type and comment inside, two lines per port. Generics with comments below the ports.
+struct FullStyle
+{
+    static const bool namesOutside = true; ///false: the name is drawn inside the box, where the type would be
+    static const bool types = true;
+    static const bool comments = true;
+    static const bool generics = true;
+};
+
+///Only the port names, inside the box. No types, comments or generics.
+struct MinimalStyle
+{
+    static const bool namesOutside = false;
+    static const bool types = false;
+    static const bool comments = false;
+    static const bool generics = false;
+};
+
+///One line per port: name outside, type inside the box, no comments. Generics without comments.
+struct CompactStyle
+{
+    static const bool namesOutside = true;
+    static const bool types = true;
+    static const bool comments = false;
+    static const bool generics = true;
+};
+
+#endif // SYMBOLSTYLE_H